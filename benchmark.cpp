@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "deque.h"
+
+/**
+ * Набор бенчмарков дека.
+ *
+ * Для каждого сочетания контейнера, размера элемента и сценария выполняет прогревочные
+ * прогоны и заданное количество замеров, а затем печатает медиану, p99 и минимум
+ * времени одной операции. Человекочитаемая таблица пишется в stderr,
+ * результаты в формате CSV или JSON — в stdout.
+ *
+ * Параметры: --format=csv|json, --size=N, --repetitions=N, --warmup=N, --filter=подстрока.
+ */
+
+using namespace std;
+using namespace Smoren::Containers;
+
+/**
+ * @brief не дает оптимизатору выбросить вычисление value
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief элемент заданного размера; payload[0] служит значением
+ */
+template <size_t Bytes>
+struct Element {
+    static_assert(Bytes % sizeof(uint32_t) == 0, "Bytes must be a multiple of 4");
+
+    Element() = default;
+    explicit Element(uint32_t value) {
+        payload.fill(value);
+    }
+
+    array<uint32_t, Bytes/sizeof(uint32_t)> payload;
+};
+
+struct Options {
+    string format = "csv";
+    size_t size = 100000;
+    size_t repetitions = 15;
+    size_t warmup = 2;
+    string filter;
+};
+
+struct Result {
+    string container;
+    size_t elementBytes;
+    string workload;
+    size_t operations;
+    double medianNs;
+    double p99Ns;
+    double minNs;
+};
+
+/**
+ * @brief возвращает значение перцентиля percent из отсортированной выборки
+ */
+double percentile(const vector<double>& sorted, double percent) {
+    const size_t rank = static_cast<size_t>(percent/100.0*sorted.size()+0.999999);
+    return sorted[min(sorted.size(), max<size_t>(rank, 1))-1];
+}
+
+template <typename C, typename = void>
+struct HasPushFront : false_type {};
+
+template <typename C>
+struct HasPushFront<C, void_t<decltype(declval<C&>().push_front(declval<typename C::value_type>()))>> : true_type {};
+
+template <typename T, size_t ChunkCapacity, typename... Options>
+void bulkFill(Deque<T, ChunkCapacity, Options...>& d, const T* values, size_t count) {
+    d.append(values, count);
+}
+
+template <typename C>
+void bulkFill(C& c, const typename C::value_type* values, size_t count) {
+    c.insert(c.end(), values, values+count);
+}
+
+template <typename T, size_t ChunkCapacity, typename... Options>
+void bulkDrain(Deque<T, ChunkCapacity, Options...>& d, vector<T>& output) {
+    d.drain_front(output.data(), output.size());
+}
+
+template <typename C>
+void bulkDrain(C& c, vector<typename C::value_type>& output) {
+    copy(c.begin(), c.end(), output.begin());
+    c.clear();
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& options): options(options) {}
+
+    /**
+     * @brief прогоняет все применимые к контейнеру C сценарии; make создает пустой контейнер
+     */
+    template <typename C, typename Factory>
+    void container(const string& name, Factory make) {
+        using T = typename C::value_type;
+        const size_t n = options.size;
+        const vector<T> values = makeValues<T>(n);
+        const vector<size_t> indexes = makeIndexes(n);
+
+        if constexpr(HasPushFront<C>::value) {
+            measure<C>(name, sizeof(T), "fifo", n, make,
+                [&](C& c) { for(size_t i=0; i<n; i++) c.push_back(values[i]); },
+                [&](C& c) {
+                    for(size_t i=0; i<n; i++) {
+                        c.push_back(values[i]);
+                        doNotOptimize(c[0]);
+                        c.pop_front();
+                    }
+                });
+            measure<C>(name, sizeof(T), "alternating", 2*n, make,
+                [](C&) {},
+                [&](C& c) {
+                    for(size_t i=0; i<n; i+=2) {
+                        c.push_back(values[i]);
+                        c.push_front(values[i+1]);
+                    }
+                    for(size_t i=0; i<n; i+=2) {
+                        doNotOptimize(c[c.size()-1]);
+                        c.pop_back();
+                        doNotOptimize(c[0]);
+                        c.pop_front();
+                    }
+                });
+        }
+        measure<C>(name, sizeof(T), "lifo", 2*n, make,
+            [](C&) {},
+            [&](C& c) {
+                for(size_t i=0; i<n; i++) {
+                    c.push_back(values[i]);
+                }
+                for(size_t i=0; i<n; i++) {
+                    doNotOptimize(c[c.size()-1]);
+                    c.pop_back();
+                }
+            });
+        measure<C>(name, sizeof(T), "random_index", n, make,
+            [&](C& c) { for(size_t i=0; i<n; i++) c.push_back(values[i]); },
+            [&](C& c) {
+                uint64_t sum = 0;
+                for(size_t index : indexes) {
+                    sum += c[index].payload[0];
+                }
+                doNotOptimize(sum);
+            });
+        measure<C>(name, sizeof(T), "iteration", n, make,
+            [&](C& c) { for(size_t i=0; i<n; i++) c.push_back(values[i]); },
+            [&](C& c) {
+                uint64_t sum = 0;
+                for(const T& item : c) {
+                    sum += item.payload[0];
+                }
+                doNotOptimize(sum);
+            });
+        vector<T> output(n);
+        measure<C>(name, sizeof(T), "bulk_fill_drain", 2*n, make,
+            [](C&) {},
+            [&](C& c) {
+                bulkFill(c, values.data(), n);
+                bulkDrain(c, output);
+                doNotOptimize(output[n-1]);
+            });
+    }
+
+    const vector<Result>& getResults() const {
+        return results;
+    }
+
+protected:
+    Options options;
+    vector<Result> results;
+
+    template <typename T>
+    static vector<T> makeValues(size_t n) {
+        vector<T> values;
+        values.reserve(n+1);
+        for(size_t i=0; i<=n; i++) {
+            values.emplace_back(static_cast<uint32_t>(i));
+        }
+        return values;
+    }
+
+    static vector<size_t> makeIndexes(size_t n) {
+        mt19937 generator(42);
+        uniform_int_distribution<size_t> distribution(0, n-1);
+        vector<size_t> indexes(n);
+        for(size_t& index : indexes) {
+            index = distribution(generator);
+        }
+        return indexes;
+    }
+
+    /**
+     * @brief замеряет сценарий: setup готовит свежий контейнер вне замера, body выполняет operations операций
+     */
+    template <typename C, typename Factory, typename Setup, typename Body>
+    void measure(const string& container, size_t elementBytes, const string& workload, size_t operations, Factory& make, Setup setup, Body body) {
+        const string label = container + " " + to_string(elementBytes) + "B " + workload;
+        if(!options.filter.empty() && label.find(options.filter) == string::npos) {
+            return;
+        }
+
+        vector<double> samples;
+        samples.reserve(options.repetitions);
+        for(size_t run=0; run<options.warmup+options.repetitions; run++) {
+            unique_ptr<C> c = make();
+            setup(*c);
+
+            const auto start = chrono::steady_clock::now();
+            body(*c);
+            const auto finish = chrono::steady_clock::now();
+
+            if(run >= options.warmup) {
+                samples.push_back(chrono::duration<double, nano>(finish-start).count()/operations);
+            }
+        }
+        sort(samples.begin(), samples.end());
+
+        const Result result = {container, elementBytes, workload, operations, percentile(samples, 50), percentile(samples, 99), samples.front()};
+        results.push_back(result);
+        cerr << label << ": median " << result.medianNs << " ns/op, p99 " << result.p99Ns << " ns/op" << endl;
+    }
+};
+
+template <typename T>
+void benchmarkElement(Runner& runner) {
+    runner.container<Deque<T, 64>>("Deque<64>", []() { return make_unique<Deque<T, 64>>(); });
+    runner.container<Deque<T, 1024>>("Deque<1024>", []() { return make_unique<Deque<T, 1024>>(); });
+    runner.container<Deque<T>>("Deque(ChunkBytes{4096})", []() { return make_unique<Deque<T>>(ChunkBytes{4096}); });
+    runner.container<deque<T>>("std::deque", []() { return make_unique<deque<T>>(); });
+    runner.container<vector<T>>("std::vector", []() { return make_unique<vector<T>>(); });
+}
+
+void printCsv(const vector<Result>& results) {
+    cout << "container,element_bytes,workload,operations,median_ns,p99_ns,min_ns" << endl;
+    for(const Result& r : results) {
+        cout << "\"" << r.container << "\"," << r.elementBytes << "," << r.workload << "," << r.operations << ","
+             << r.medianNs << "," << r.p99Ns << "," << r.minNs << endl;
+    }
+}
+
+void printJson(const vector<Result>& results) {
+    cout << "[" << endl;
+    for(size_t i=0; i<results.size(); i++) {
+        const Result& r = results[i];
+        cout << "  {\"container\": \"" << r.container << "\", \"element_bytes\": " << r.elementBytes
+             << ", \"workload\": \"" << r.workload << "\", \"operations\": " << r.operations
+             << ", \"median_ns\": " << r.medianNs << ", \"p99_ns\": " << r.p99Ns << ", \"min_ns\": " << r.minNs << "}"
+             << (i+1 < results.size() ? "," : "") << endl;
+    }
+    cout << "]" << endl;
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for(int i=1; i<argc; i++) {
+        const string argument = argv[i];
+        const size_t separator = argument.find('=');
+        const string name = argument.substr(0, separator);
+        const string value = separator == string::npos ? "" : argument.substr(separator+1);
+
+        if(name == "--format") {
+            options.format = value;
+        } else if(name == "--size") {
+            options.size = max<size_t>(stoul(value), 2);
+        } else if(name == "--repetitions") {
+            options.repetitions = max<size_t>(stoul(value), 1);
+        } else if(name == "--warmup") {
+            options.warmup = stoul(value);
+        } else if(name == "--filter") {
+            options.filter = value;
+        } else {
+            throw invalid_argument("unknown option " + argument);
+        }
+    }
+    if(options.format != "csv" && options.format != "json") {
+        throw invalid_argument("format must be csv or json");
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch(const exception& e) {
+        cerr << e.what() << endl;
+        cerr << "usage: " << argv[0] << " [--format=csv|json] [--size=N] [--repetitions=N] [--warmup=N] [--filter=text]" << endl;
+        return 1;
+    }
+
+    Runner runner(options);
+    benchmarkElement<Element<4>>(runner);
+    benchmarkElement<Element<16>>(runner);
+    benchmarkElement<Element<64>>(runner);
+    benchmarkElement<Element<256>>(runner);
+
+    if(options.format == "json") {
+        printJson(runner.getResults());
+    } else {
+        printCsv(runner.getResults());
+    }
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = deque_benchmark
+CONFIG += console c++17 release
+CONFIG -= app_bundle
+CONFIG -= qt
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_LFLAGS += -pthread
+
+SOURCES += benchmark.cpp
+
+HEADERS += \
+    deque.h \
+    printer.h
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace Smoren::Containers {
+    /**
+     * @brief арена для чанков деков
+     *
+     * Выделяет память большими блоками и раздает ее сдвигом указателя, выравнивая
+     * каждый участок по кэш-линии. Освобожденные участки складываются в списки
+     * по размеру и выдаются повторно, поэтому дек, который постоянно создает
+     * и освобождает чанки одного размера, не растит арену. Списков не больше
+     * maxBinnedSize/cacheLineSize; участки крупнее maxBinnedSize и участки с выравниванием
+     * больше кэш-линии попадают в общий список крупных участков и выдаются повторно
+     * для запроса того же размера, если адрес участка подходит под запрошенное выравнивание.
+     * reset() разом возвращает всю выданную память, оставляя за собой первый блок,
+     * release() отдает системе все блоки; деки, использующие арену, к этому моменту
+     * должны быть уничтожены.
+     *
+     * Блоки можно выделять через mmap с выравниванием по 2 МБ и просить ядро
+     * подложить под них прозрачные huge pages, чтобы сократить промахи TLB
+     * при обходе больших деков.
+     */
+    class ChunkArena : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t cacheLineSize = 64;
+        static constexpr size_t hugePageSize = 2*1024*1024;
+        static constexpr size_t maxBinnedSize = 64*1024;
+
+        struct Options {
+            size_t blockSize = hugePageSize;
+            bool useHugePages = false;
+        };
+
+        ChunkArena(): ChunkArena(Options()) {}
+
+        explicit ChunkArena(const Options& options):
+            options(options),
+            current(nullptr),
+            currentEnd(nullptr)
+        {}
+
+        ChunkArena(const ChunkArena& arena) = delete;
+        ChunkArena& operator =(const ChunkArena& arena) = delete;
+
+        ~ChunkArena() override {
+            release();
+        }
+
+        /**
+         * @brief возвращает всю выданную память в арену, сохраняя первый блок для следующих выделений
+         */
+        void reset() {
+            if(blocks.empty()) {
+                return;
+            }
+            for(size_t i=1; i<blocks.size(); i++) {
+                freeBlock(blocks[i]);
+            }
+            blocks.resize(1);
+            std::fill(freeLists.begin(), freeLists.end(), nullptr);
+            largeFreeList = nullptr;
+            current = static_cast<char*>(blocks[0].data);
+            currentEnd = current+blocks[0].size;
+        }
+
+        /**
+         * @brief отдает системе всю память арены
+         */
+        void release() {
+            for(const Block& block : blocks) {
+                freeBlock(block);
+            }
+            blocks.clear();
+            freeLists.clear();
+            largeFreeList = nullptr;
+            current = currentEnd = nullptr;
+        }
+
+        /**
+         * @brief возвращает суммарный размер блоков, полученных от системы
+         */
+        size_t reservedBytes() const {
+            size_t result = 0;
+            for(const Block& block : blocks) {
+                result += block.size;
+            }
+            return result;
+        }
+
+    protected:
+        struct Block {
+            void* data;
+            size_t size;
+            bool mapped;
+        };
+
+        struct FreeNode {
+            FreeNode* next;
+        };
+
+        struct LargeFreeNode {
+            LargeFreeNode* next;
+            size_t size;
+        };
+
+        Options options;
+        std::vector<Block> blocks;
+        // списки по размеру с шагом в кэш-линию, не длиннее maxBinnedSize/cacheLineSize+1
+        std::vector<FreeNode*> freeLists;
+        LargeFreeNode* largeFreeList = nullptr;
+        char* current;
+        char* currentEnd;
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            const size_t size = roundUp(std::max<size_t>(bytes, 1), cacheLineSize);
+            alignment = std::max(alignment, cacheLineSize);
+
+            if(isBinned(size, alignment)) {
+                const size_t bin = size/cacheLineSize;
+                if(bin >= freeLists.size()) {
+                    freeLists.resize(bin+1, nullptr);
+                }
+                if(freeLists[bin] != nullptr) {
+                    FreeNode* node = freeLists[bin];
+                    freeLists[bin] = node->next;
+                    return node;
+                }
+            } else if(void* reused = takeLarge(size, alignment)) {
+                return reused;
+            }
+
+            char* position = alignPointer(current, alignment);
+            if(current == nullptr || position+size > currentEnd) {
+                allocateBlock(size+alignment);
+                position = alignPointer(current, alignment);
+            }
+            current = position+size;
+            return position;
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+            const size_t size = roundUp(std::max<size_t>(bytes, 1), cacheLineSize);
+            alignment = std::max(alignment, cacheLineSize);
+
+            if(isBinned(size, alignment)) {
+                // список для этого размера создан еще при выделении
+                const size_t bin = size/cacheLineSize;
+                FreeNode* node = static_cast<FreeNode*>(pointer);
+                node->next = freeLists[bin];
+                freeLists[bin] = node;
+                return;
+            }
+            LargeFreeNode* node = static_cast<LargeFreeNode*>(pointer);
+            node->next = largeFreeList;
+            node->size = size;
+            largeFreeList = node;
+        }
+
+        static bool isBinned(size_t size, size_t alignment) {
+            return size <= maxBinnedSize && alignment == cacheLineSize;
+        }
+
+        /**
+         * @brief забирает из списка крупных участков участок размера size с подходящим выравниванием
+         */
+        void* takeLarge(size_t size, size_t alignment) {
+            for(LargeFreeNode** link = &largeFreeList; *link != nullptr; link = &(*link)->next) {
+                LargeFreeNode* node = *link;
+                if(node->size == size && reinterpret_cast<uintptr_t>(node)%alignment == 0) {
+                    *link = node->next;
+                    return node;
+                }
+            }
+            return nullptr;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        static size_t roundUp(size_t value, size_t alignment) {
+            return (value+alignment-1)/alignment*alignment;
+        }
+
+        static char* alignPointer(char* pointer, size_t alignment) {
+            const uintptr_t value = reinterpret_cast<uintptr_t>(pointer);
+            return reinterpret_cast<char*>((value+alignment-1)/alignment*alignment);
+        }
+
+        void allocateBlock(size_t minSize) {
+            Block block;
+            block.size = roundUp(std::max(minSize, options.blockSize), options.useHugePages ? hugePageSize : cacheLineSize);
+            block.data = nullptr;
+            block.mapped = false;
+
+#ifdef __linux__
+            if(options.useHugePages) {
+                block.data = mapHugePages(block.size);
+                block.mapped = block.data != nullptr;
+            }
+#endif
+            if(block.data == nullptr) {
+                block.data = ::operator new(block.size, std::align_val_t(cacheLineSize));
+            }
+
+            try {
+                blocks.push_back(block);
+            } catch(...) {
+                freeBlock(block);
+                throw;
+            }
+            current = static_cast<char*>(block.data);
+            currentEnd = current+block.size;
+        }
+
+#ifdef __linux__
+        /**
+         * @brief отображает анонимную память, выровненную по 2 МБ, и включает для нее huge pages
+         */
+        static void* mapHugePages(size_t size) {
+            void* raw = mmap(nullptr, size+hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(raw == MAP_FAILED) {
+                return nullptr;
+            }
+
+            char* begin = static_cast<char*>(raw);
+            char* aligned = alignPointer(begin, hugePageSize);
+            if(aligned != begin) {
+                munmap(begin, aligned-begin);
+            }
+            const size_t tail = (begin+size+hugePageSize)-(aligned+size);
+            if(tail) {
+                munmap(aligned+size, tail);
+            }
+
+            madvise(aligned, size, MADV_HUGEPAGE);
+            return aligned;
+        }
+#endif
+
+        static void freeBlock(const Block& block) {
+#ifdef __linux__
+            if(block.mapped) {
+                munmap(block.data, block.size);
+                return;
+            }
+#endif
+            ::operator delete(block.data, std::align_val_t(cacheLineSize));
+        }
+    };
+}
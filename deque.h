@@ -1,39 +1,151 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <list>
 #include "printer.h"
 
+#if __cplusplus > 201703L
+#include <span>
+#endif
+
 namespace Smoren::Containers {
+    /**
+     * @brief возвращает двоичный логарифм степени двойки
+     */
+    constexpr size_t log2PowerOfTwo(size_t value) {
+        return value <= 1 ? 0 : 1 + log2PowerOfTwo(value >> 1);
+    }
+
+    /**
+     * @brief возвращает наибольшую степень двойки элементов T, умещающуюся в bytes байт, но не меньше 1
+     *
+     * Подходит и как ChunkCapacity: Deque<Order, chunkCapacityForBytes<Order>(4096)>.
+     */
     template <typename T>
-    class Chunk {
+    constexpr size_t chunkCapacityForBytes(size_t bytes) {
+        const size_t count = bytes/sizeof(T);
+        return count <= 1 ? 1 : size_t(1) << log2PowerOfTwo(count);
+    }
+
+    /**
+     * @brief размер чанка в байтах для конструктора Deque
+     *
+     * Если maxBytes больше bytes, размер чанка растет вдвое по мере роста дека, пока не достигнет maxBytes.
+     */
+    struct ChunkBytes {
+        size_t bytes = 4096;
+        size_t maxBytes = 0;
+    };
+
+    /**
+     * @brief неинициализированное хранилище элементов чанка, вместимость которого известна на этапе компиляции
+     *
+     * Память под элементы находится прямо внутри объекта чанка, без отдельного выделения.
+     */
+    template <typename T, size_t Capacity, typename Allocator = std::allocator<T>>
+    class ChunkStorage {
+    public:
+        explicit ChunkStorage(size_t, const Allocator& = Allocator()) {}
+
+    protected:
+        static constexpr size_t capacity = Capacity;
+
+        T* data() {
+            return reinterpret_cast<T*>(buffer);
+        }
+
+        const T* data() const {
+            return reinterpret_cast<const T*>(buffer);
+        }
+
+    private:
+        alignas(T) unsigned char buffer[Capacity*sizeof(T)];
+    };
+
+    /**
+     * @brief неинициализированное хранилище элементов чанка, вместимость которого задается во время выполнения
+     *
+     * Память выделяется аллокатором дека.
+     */
+    template <typename T, typename Allocator>
+    class ChunkStorage<T, 0, Allocator> {
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+
     public:
-        explicit Chunk(size_t capacity):
+        explicit ChunkStorage(size_t capacity, const Allocator& allocator = Allocator()):
             capacity(capacity),
+            allocator(allocator),
+            buffer(AllocatorTraits::allocate(this->allocator, capacity))
+        {}
+
+        ChunkStorage(const ChunkStorage& storage) = delete;
+        ChunkStorage& operator =(const ChunkStorage& storage) = delete;
+
+        ~ChunkStorage() {
+            AllocatorTraits::deallocate(allocator, buffer, capacity);
+        }
+
+    protected:
+        size_t capacity;
+        Allocator allocator;
+
+        T* data() {
+            return buffer;
+        }
+
+        const T* data() const {
+            return buffer;
+        }
+
+    private:
+        T* buffer;
+    };
+
+    /**
+     * @brief непрерывный участок дека
+     *
+     * Память под элементы не инициализируется заранее: элементы создаются
+     * при добавлении и уничтожаются при удалении.
+     */
+    template <typename T, size_t Capacity = 0, typename Allocator = std::allocator<T>>
+    class Chunk : protected ChunkStorage<T, Capacity, Allocator> {
+        using Storage = ChunkStorage<T, Capacity, Allocator>;
+        using Storage::capacity;
+        using Storage::data;
+
+    public:
+        explicit Chunk(size_t capacity = Capacity, const Allocator& allocator = Allocator()):
+            Storage(capacity, allocator),
             _head(nullptr),
             _end(nullptr)
-        {
-            data = new T[capacity];
-        }
+        {}
 
-        Chunk(const Chunk& chunk): Chunk(chunk.capacity) {
+        Chunk(const Chunk& chunk, const Allocator& allocator = Allocator()): Chunk(chunk.capacity, allocator) {
             if(!chunk.empty()) {
-                _head = data+(chunk._head-chunk.data);
-                _end = data+(chunk._end-chunk.data);
-
-                std::copy(chunk._head, chunk._end, _head);
+                T* head = data()+(chunk._head-chunk.data());
+                _end = std::uninitialized_copy(chunk._head, chunk._end, head);
+                _head = head;
             }
         }
 
+        Chunk& operator =(const Chunk& chunk) = delete;
+
         ~Chunk() {
-            delete[] data;
+            clear();
         }
 
         bool empty() const { return _head == _end; }
-        bool full() const { return _head == &data[0] && _end == &data[capacity]; }
-        bool full_left() const { return _head == &data[0]; }
-        bool full_right() const { return _end == &data[capacity]; }
+        bool full() const { return _head == data() && _end == data()+capacity; }
+        bool full_left() const { return _head == data(); }
+        bool full_right() const { return _end == data()+capacity; }
 
         T* begin() { return _head; }
         T* end() { return _end; }
@@ -47,52 +159,172 @@ namespace Smoren::Containers {
         const T* rbegin() const { return _end-1; }
         const T* rend() const { return _head-1; }
 
-        void push_front(const T& value) {
+        template <typename... Args>
+        T& emplace_front(Args&&... args) {
+            T* position = empty() ? data() : _head-1;
+            new(position) T(std::forward<Args>(args)...);
             if(empty()) {
-                _head = &data[0];
-                _end = _head+1;
-            } else {
-                _head--;
+                _end = position+1;
             }
-            *_head = value;
+            _head = position;
+            return *position;
         }
 
-        void push_back(const T& value) {
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            T* position = empty() ? data()+capacity-1 : _end;
+            new(position) T(std::forward<Args>(args)...);
             if(empty()) {
-                _head = &data[capacity-1];
-                _end = &data[capacity];
-                *_head = value;
-            } else {
-                *_end = value;
-                _end++;
+                _head = position;
             }
+            _end = position+1;
+            return *position;
+        }
+
+        void push_front(const T& value) {
+            emplace_front(value);
+        }
+
+        void push_front(T&& value) {
+            emplace_front(std::move(value));
+        }
+
+        void push_back(const T& value) {
+            emplace_back(value);
+        }
+
+        void push_back(T&& value) {
+            emplace_back(std::move(value));
         }
 
         void pop_front() {
+            destroy(_head, _head+1);
             _head++;
         }
 
         void pop_back() {
             _end--;
+            destroy(_end, _end+1);
+        }
+
+        /**
+         * @brief удаляет count первых элементов
+         */
+        void pop_front_n(size_t count) {
+            destroy(_head, _head+count);
+            _head += count;
+        }
+
+        /**
+         * @brief удаляет count последних элементов
+         */
+        void pop_back_n(size_t count) {
+            destroy(_end-count, _end);
+            _end -= count;
+        }
+
+        /**
+         * @brief копирует count элементов из first вплотную после последнего элемента чанка
+         *
+         * В пустом чанке элементы размещаются с начала памяти.
+         * Возвращает итератор на первый нескопированный элемент.
+         */
+        template <typename ForwardIt>
+        ForwardIt fill_back(ForwardIt first, size_t count) {
+            T* position = empty() ? data() : _end;
+            first = construct(first, count, position);
+            if(empty()) {
+                _head = position;
+            }
+            _end = position+count;
+            return first;
+        }
+
+        /**
+         * @brief копирует count элементов из first вплотную перед первым элементом чанка, сохраняя их порядок
+         *
+         * В пустом чанке элементы размещаются в конце памяти.
+         * Возвращает итератор на первый нескопированный элемент.
+         */
+        template <typename ForwardIt>
+        ForwardIt fill_front(ForwardIt first, size_t count) {
+            T* position = (empty() ? data()+capacity : _head)-count;
+            first = construct(first, count, position);
+            if(empty()) {
+                _end = position+count;
+            }
+            _head = position;
+            return first;
+        }
+
+        /**
+         * @brief добавляет count мест вплотную после последнего элемента, не инициализируя их
+         *
+         * Только для тривиально копируемых T: вызывающий сразу записывает в них байты элементов.
+         * В пустом чанке места выделяются с начала памяти. Возвращает указатель на первое место.
+         */
+        T* extend_back(size_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+            T* position = empty() ? data() : _end;
+            if(empty()) {
+                _head = position;
+            }
+            _end = position+count;
+            return position;
+        }
+
+        /**
+         * @brief возвращает количество свободных мест перед первым элементом
+         */
+        size_t space_front() const {
+            return empty() ? capacity : _head-data();
+        }
+
+        /**
+         * @brief возвращает количество свободных мест после последнего элемента
+         */
+        size_t space_back() const {
+            return empty() ? capacity : data()+capacity-_end;
+        }
+
+        /**
+         * @brief уничтожает все элементы чанка
+         */
+        void clear() {
+            destroy(_head, _end);
+            _head = _end = nullptr;
         }
 
         T& operator [](size_t i) {
-            return data[i];
+            return data()[i];
+        }
+
+        const T& operator [](size_t i) const {
+            return data()[i];
         }
 
         size_t size() const {
             return _end - _head;
         }
 
-        T* getData() const {
-            return data;
+        T* getData() {
+            return data();
+        }
+
+        const T* getData() const {
+            return data();
         }
 
         void printData() const {
             std::cout << "<";
 
             for(size_t i=0; i<capacity; i++) {
-                std::cout << data[i] << ", ";
+                const T* item = data()+i;
+                if(item >= _head && item < _end) {
+                    std::cout << *item << ", ";
+                } else {
+                    std::cout << "_, ";
+                }
             }
 
             std::cout << "> (";
@@ -112,494 +344,1793 @@ namespace Smoren::Containers {
             std::cout << ")" << std::endl;
         }
 
-        friend std::ostream& operator <<(std::ostream& stream, const Chunk& item) {
-            return stream << "<" << Smoren::Tools::join(item, ", ") << ">";
+        friend std::ostream& operator <<(std::ostream& stream, const Chunk& item) {
+            return stream << "<" << Smoren::Tools::join(item, ", ") << ">";
+        }
+
+    protected:
+        T* _head;
+        T* _end;
+
+        /**
+         * @brief уничтожает элементы диапазона; для тривиально разрушаемых типов ничего не делает
+         */
+        static void destroy(T* first, T* last) {
+            if constexpr(!std::is_trivially_destructible_v<T>) {
+                for(; first != last; ++first) {
+                    first->~T();
+                }
+            }
+        }
+
+        /**
+         * @brief создает count копий элементов из first в неинициализированной памяти destination
+         *
+         * Для тривиально копируемых типов из непрерывного источника копирует одним memcpy.
+         * Если конструктор бросает исключение, уже созданные элементы уничтожаются.
+         */
+        template <typename ForwardIt>
+        static ForwardIt construct(ForwardIt first, size_t count, T* destination) {
+            if constexpr(std::is_trivially_copyable_v<T> && std::is_pointer_v<ForwardIt>
+                && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<ForwardIt>>, T>) {
+                if(count) {
+                    std::memcpy(static_cast<void*>(destination), first, count*sizeof(T));
+                }
+                return first+count;
+            } else {
+                T* current = destination;
+                try {
+                    for(; count; --count, ++first, ++current) {
+                        new(current) T(*first);
+                    }
+                } catch(...) {
+                    destroy(destination, current);
+                    throw;
+                }
+                return first;
+            }
+        }
+    };
+
+    /**
+     * @brief непрерывный диапазон элементов одного чанка
+     */
+    template <typename T>
+    struct Segment {
+        T* first;
+        T* last;
+
+        T* begin() const { return first; }
+        T* end() const { return last; }
+
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+    /**
+     * @brief статистика дека, которую возвращает Deque::stats()
+     *
+     * Счетчики событий и пиковые значения ведет только политика CountingDequeStats,
+     * с NoDequeStats они нулевые. Текущее состояние вычисляется при вызове stats() с любой политикой.
+     */
+    struct DequeStats {
+        size_t chunkAllocations = 0;   // чанков выделено у аллокатора
+        size_t chunkFrees = 0;         // чанков возвращено аллокатору
+        size_t spareChunkReuses = 0;   // чанков взято из запаса вместо выделения
+        size_t indexReallocations = 0; // перевыделений индекса чанков
+        size_t repacks = 0;            // переупаковок в чанки большей вместимости
+        size_t peakSize = 0;
+        size_t peakChunks = 0;
+
+        size_t size = 0;
+        size_t chunks = 0;
+        size_t spareChunks = 0;
+        size_t chunkCapacity = 0;
+        size_t indexCapacity = 0;      // ячеек в индексе чанков
+        size_t leftShift = 0;          // свободных мест в первом чанке перед первым элементом
+        size_t liveBytes = 0;          // байт под живыми элементами
+        size_t residentBytes = 0;      // байт под чанками, включая запасные, и индексом
+
+        friend std::ostream& operator <<(std::ostream& stream, const DequeStats& stats) {
+            return stream << "size: " << stats.size << " (peak " << stats.peakSize << ")"
+                          << ", chunks: " << stats.chunks << " (peak " << stats.peakChunks << ", spare " << stats.spareChunks << ")"
+                          << ", chunk capacity: " << stats.chunkCapacity
+                          << ", index: " << stats.chunks << " | " << stats.indexCapacity << " (reallocations " << stats.indexReallocations << ")"
+                          << ", left shift: " << stats.leftShift
+                          << ", chunk allocations: " << stats.chunkAllocations << ", frees: " << stats.chunkFrees
+                          << ", spare reuses: " << stats.spareChunkReuses << ", repacks: " << stats.repacks
+                          << ", bytes: " << stats.liveBytes << " live / " << stats.residentBytes << " resident";
+        }
+    };
+
+    /**
+     * @brief политика статистики по умолчанию: ничего не считает и не занимает места, а вызовы ее методов исчезают при компиляции
+     */
+    struct NoDequeStats {
+        static constexpr bool enabled = false;
+
+        void onChunkAllocated() {}
+        void onChunkFreed() {}
+        void onSpareChunkReused() {}
+        void onIndexReallocated() {}
+        void onRepacked() {}
+        void onSizeGrown(size_t) {}
+        void onChunkAdded(size_t) {}
+        void collect(DequeStats&) const {}
+    };
+
+    /**
+     * @brief политика статистики, считающая внутренние события дека
+     */
+    class CountingDequeStats {
+    public:
+        static constexpr bool enabled = true;
+
+        void onChunkAllocated() { ++chunkAllocations; }
+        void onChunkFreed() { ++chunkFrees; }
+        void onSpareChunkReused() { ++spareChunkReuses; }
+        void onIndexReallocated() { ++indexReallocations; }
+        void onRepacked() { ++repacks; }
+
+        void onSizeGrown(size_t size) {
+            peakSize = std::max(peakSize, size);
+        }
+
+        void onChunkAdded(size_t chunksCount) {
+            peakChunks = std::max(peakChunks, chunksCount);
+        }
+
+        /**
+         * @brief добавляет накопленные счетчики к stats
+         */
+        void collect(DequeStats& stats) const {
+            stats.chunkAllocations += chunkAllocations;
+            stats.chunkFrees += chunkFrees;
+            stats.spareChunkReuses += spareChunkReuses;
+            stats.indexReallocations += indexReallocations;
+            stats.repacks += repacks;
+            stats.peakSize = std::max(stats.peakSize, peakSize);
+            stats.peakChunks = std::max(stats.peakChunks, peakChunks);
+        }
+
+    protected:
+        size_t chunkAllocations = 0;
+        size_t chunkFrees = 0;
+        size_t spareChunkReuses = 0;
+        size_t indexReallocations = 0;
+        size_t repacks = 0;
+        size_t peakSize = 0;
+        size_t peakChunks = 0;
+    };
+
+    /**
+     * @brief снимок устройства дека: статистика и заполненность каждого чанка
+     */
+    struct DequeReport {
+        DequeStats stats;
+        std::vector<size_t> chunkSizes;
+
+        friend std::ostream& operator <<(std::ostream& stream, const DequeReport& report) {
+            return stream << report.stats << ", chunk sizes: [" << Smoren::Tools::join(report.chunkSizes, ", ") << "]";
+        }
+    };
+
+    /**
+     * @brief кольцевой буфер указателей на чанки дека
+     *
+     * Освободившиеся с одной стороны ячейки переиспользуются при добавлении с другой,
+     * поэтому размер буфера ограничен максимальным количеством чанков в деке.
+     * При заполнении буфер удваивается, а чанки переносятся в его начало.
+     *
+     * Перевыделения буфера учитывает политика статистики Stats.
+     */
+    template <typename T, size_t ChunkCapacity = 0, typename Allocator = std::allocator<T>, typename Stats = NoDequeStats>
+    class ChunkMap : protected Stats {
+
+    public:
+        using ChunkType = Chunk<T, ChunkCapacity, Allocator>;
+        using PointerAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ChunkType*>;
+        using PointerAllocatorTraits = std::allocator_traits<PointerAllocator>;
+
+        static constexpr size_t minCapacity = 8;
+
+        explicit ChunkMap(const Allocator& allocator = Allocator()):
+            allocator(allocator),
+            data(nullptr),
+            _capacity(0),
+            _head(0),
+            _size(0)
+        {}
+
+        ChunkMap(const ChunkMap& map) = delete;
+        ChunkMap& operator =(const ChunkMap& map) = delete;
+
+        ChunkMap(ChunkMap&& map) noexcept:
+            Stats(std::move(map)),
+            allocator(map.allocator),
+            data(std::exchange(map.data, nullptr)),
+            _capacity(std::exchange(map._capacity, 0)),
+            _head(std::exchange(map._head, 0)),
+            _size(std::exchange(map._size, 0))
+        {}
+
+        /**
+         * @brief забирает буфер map; если аллокаторы не передаются и не равны, копирует указатели в свой буфер
+         */
+        ChunkMap& operator =(ChunkMap&& map) noexcept(
+            PointerAllocatorTraits::propagate_on_container_move_assignment::value ||
+            PointerAllocatorTraits::is_always_equal::value
+        ) {
+            if(this == &map) {
+                return *this;
+            }
+            release();
+            Stats::operator =(std::move(map));
+            if constexpr(!PointerAllocatorTraits::propagate_on_container_move_assignment::value) {
+                if(!(allocator == map.allocator)) {
+                    reserve(map._size);
+                    for(size_t i=0; i<map._size; i++) {
+                        push_back(map[i]);
+                    }
+                    map.release();
+                    return *this;
+                }
+            } else {
+                allocator = map.allocator;
+            }
+            data = std::exchange(map.data, nullptr);
+            _capacity = std::exchange(map._capacity, 0);
+            _head = std::exchange(map._head, 0);
+            _size = std::exchange(map._size, 0);
+            return *this;
+        }
+
+        ~ChunkMap() {
+            release();
+        }
+
+        /**
+         * @brief обменивается буферами с map; аллокаторы меняются местами, только если они передаются при обмене
+         */
+        void swap(ChunkMap& map) noexcept {
+            using std::swap;
+            if constexpr(PointerAllocatorTraits::propagate_on_container_swap::value) {
+                swap(allocator, map.allocator);
+            }
+            swap(static_cast<Stats&>(*this), static_cast<Stats&>(map));
+            swap(data, map.data);
+            swap(_capacity, map._capacity);
+            swap(_head, map._head);
+            swap(_size, map._size);
+        }
+
+        ChunkType* operator [](size_t index) const {
+            return data[(_head+index) & (_capacity-1)];
+        }
+
+        ChunkType* front() const {
+            return data[_head];
+        }
+
+        ChunkType* back() const {
+            return (*this)[_size-1];
+        }
+
+        /**
+         * @brief гарантирует место под count чанков без перевыделения буфера
+         */
+        void reserve(size_t count) {
+            if(count > _capacity) {
+                size_t newCapacity = _capacity ? _capacity : minCapacity;
+                while(newCapacity < count) {
+                    newCapacity *= 2;
+                }
+                reallocate(newCapacity);
+            }
+        }
+
+        /**
+         * @brief уменьшает буфер до наименьшей степени двойки, вмещающей все чанки; буфер пустого индекса освобождается
+         */
+        void shrink_to_fit() {
+            if(_size == 0) {
+                release();
+                return;
+            }
+            size_t newCapacity = minCapacity;
+            while(newCapacity < _size) {
+                newCapacity *= 2;
+            }
+            if(newCapacity < _capacity) {
+                reallocate(newCapacity);
+            }
+        }
+
+        void push_front(ChunkType* chunk) {
+            if(_size == _capacity) {
+                grow();
+            }
+            _head = (_head-1) & (_capacity-1);
+            data[_head] = chunk;
+            ++_size;
+        }
+
+        void push_back(ChunkType* chunk) {
+            if(_size == _capacity) {
+                grow();
+            }
+            data[(_head+_size) & (_capacity-1)] = chunk;
+            ++_size;
+        }
+
+        void pop_front() {
+            _head = (_head+1) & (_capacity-1);
+            --_size;
+        }
+
+        void pop_back() {
+            --_size;
+        }
+
+        size_t size() const {
+            return _size;
+        }
+
+        size_t capacity() const {
+            return _capacity;
+        }
+
+        bool empty() const {
+            return !_size;
+        }
+
+        const Stats& getStats() const {
+            return *this;
+        }
+
+        friend std::ostream& operator <<(std::ostream& stream, const ChunkMap& map) {
+            return stream << "SIZE: " << map.size() << ", CAPACITY: " << map.capacity();
+        }
+
+    protected:
+        PointerAllocator allocator;
+        ChunkType** data;
+        size_t _capacity;
+        size_t _head;
+        size_t _size;
+
+        /**
+         * @brief освобождает буфер, забывая указатели на чанки
+         */
+        void release() {
+            if(data != nullptr) {
+                PointerAllocatorTraits::deallocate(allocator, data, _capacity);
+            }
+            data = nullptr;
+            _capacity = 0;
+            _head = 0;
+            _size = 0;
+        }
+
+        /**
+         * @brief удваивает буфер
+         */
+        void grow() {
+            reallocate(_capacity ? _capacity*2 : minCapacity);
+        }
+
+        /**
+         * @brief переносит чанки в начало нового буфера заданного размера
+         */
+        void reallocate(size_t newCapacity) {
+            ChunkType** newData = PointerAllocatorTraits::allocate(allocator, newCapacity);
+
+            for(size_t i=0; i<_size; i++) {
+                newData[i] = (*this)[i];
+            }
+
+            if(data != nullptr) {
+                PointerAllocatorTraits::deallocate(allocator, data, _capacity);
+            }
+            data = newData;
+            _capacity = newCapacity;
+            _head = 0;
+            Stats::onIndexReallocated();
+        }
+    };
+
+    /**
+     * @brief дек на основе чанков
+     *
+     * Если ChunkCapacity равен нулю, вместимость чанка задается в конструкторе.
+     * Иначе она должна быть степенью двойки: чанки хранят элементы внутри себя,
+     * а индексация сводится к сдвигам и маскам.
+     *
+     * Allocator выделяет память под чанки, их элементы и индекс чанков.
+     *
+     * Вместимость, заданную в конструкторе через ChunkBytes с maxBytes, дек наращивает сам:
+     * когда элементов становится больше adaptiveChunksCount чанков, все элементы
+     * переупаковываются в чанки вдвое большей вместимости. Все чанки остаются одного размера,
+     * поэтому operator[] по-прежнему O(1), а переупаковка в среднем стоит O(1) на элемент.
+     * В этом режиме добавление элементов может сделать недействительными ссылки на них.
+     *
+     * Stats — политика внутренней статистики: NoDequeStats (по умолчанию) не стоит ничего,
+     * CountingDequeStats считает выделения чанков, рост индекса и пиковые размеры для stats().
+     */
+    template <typename T, size_t ChunkCapacity = 0, typename Allocator = std::allocator<T>, typename Stats = NoDequeStats>
+    class Deque : protected Stats {
+        static_assert((ChunkCapacity & (ChunkCapacity-1)) == 0, "ChunkCapacity must be a power of two");
+        static_assert(std::is_same_v<typename std::allocator_traits<Allocator>::value_type, T>, "Allocator::value_type must be T");
+
+    public:
+        template <bool IsConst>
+        class Iterator;
+
+        using value_type = T;
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        using allocator_type = Allocator;
+        using ChunkType = Chunk<T, ChunkCapacity, Allocator>;
+
+        /**
+         * @brief сколько освободившихся чанков дек по умолчанию держит для повторного использования
+         *
+         * По умолчанию запас выключен: распределитель общего назначения сам отдает только что
+         * освобожденный блок того же размера, и запас его не обгоняет. Запас окупается с ресурсами,
+         * которые не переиспользуют освобожденную память, например std::pmr::monotonic_buffer_resource:
+         * без него очередь FIFO выделяла бы новый чанк на каждой границе, и ресурс рос бы без предела.
+         */
+        static constexpr size_t defaultMaxSpareChunks = 0;
+
+        /**
+         * @brief при каком количестве чанков растущая вместимость чанка удваивается
+         */
+        static constexpr size_t adaptiveChunksCount = 64;
+
+        Deque(): Deque(Allocator()) {}
+
+        explicit Deque(const Allocator& allocator):
+            allocator(allocator),
+            chunkCapacity(ChunkCapacity),
+            maxChunkCapacity(ChunkCapacity),
+            leftShift(0),
+            _size(0),
+            maxSpareChunks(defaultMaxSpareChunks),
+            chunks(allocator),
+            spareChunks(allocator)
+        {
+            static_assert(ChunkCapacity != 0, "chunk capacity must be passed to constructor");
+        }
+
+        explicit Deque(size_t chunkCapacity, const Allocator& allocator = Allocator()):
+            allocator(allocator),
+            chunkCapacity(chunkCapacity),
+            maxChunkCapacity(chunkCapacity),
+            leftShift(0),
+            _size(0),
+            maxSpareChunks(defaultMaxSpareChunks),
+            chunks(allocator),
+            spareChunks(allocator)
+        {
+            static_assert(ChunkCapacity == 0, "chunk capacity is already set by template parameter");
+        }
+
+        /**
+         * @brief создает дек с чанками размером около chunkBytes.bytes байт
+         */
+        explicit Deque(const ChunkBytes& chunkBytes, const Allocator& allocator = Allocator()):
+            Deque(chunkCapacityForBytes<T>(chunkBytes.bytes), allocator)
+        {
+            maxChunkCapacity = std::max(chunkCapacity, chunkCapacityForBytes<T>(chunkBytes.maxBytes));
+        }
+
+        Deque(const Deque& d): Deque(d, AllocatorTraits::select_on_container_copy_construction(d.allocator)) {}
+
+        /**
+         * @brief копирует дек по чанкам: каждый чанк копируется целиком, расположение элементов в чанках сохраняется
+         */
+        Deque(const Deque& d, const Allocator& allocator):
+            allocator(allocator),
+            chunkCapacity(d.chunkCapacity),
+            maxChunkCapacity(d.maxChunkCapacity),
+            leftShift(0),
+            _size(0),
+            maxSpareChunks(d.maxSpareChunks),
+            chunks(allocator),
+            spareChunks(allocator)
+        {
+            chunks.reserve(d.chunks.size());
+            try {
+                for(size_t i=0; i<d.chunks.size(); i++) {
+                    addChunkToBack(copyChunk(*d.chunks[i]));
+                }
+            } catch(...) {
+                clear();
+                trimSpareChunks();
+                throw;
+            }
+            leftShift = d.leftShift;
+            growSize(d._size);
+        }
+
+        /**
+         * @brief забирает чанки d за O(1); d остается пустым с той же вместимостью чанка
+         */
+        Deque(Deque&& d) noexcept:
+            Stats(std::move(d)),
+            allocator(d.allocator),
+            chunkCapacity(d.chunkCapacity),
+            maxChunkCapacity(d.maxChunkCapacity),
+            leftShift(std::exchange(d.leftShift, 0)),
+            _size(std::exchange(d._size, 0)),
+            maxSpareChunks(d.maxSpareChunks),
+            chunks(std::move(d.chunks)),
+            spareChunks(std::move(d.spareChunks)),
+            chunkLeft(std::exchange(d.chunkLeft, nullptr)),
+            chunkRight(std::exchange(d.chunkRight, nullptr))
+        {}
+
+        Deque& operator =(const Deque& d) {
+            if(this != &d) {
+                if constexpr(AllocatorTraits::propagate_on_container_copy_assignment::value) {
+                    Deque copy(d, d.allocator);
+                    clear();
+                    trimSpareChunks();
+                    allocator = d.allocator;
+                    takeOver(copy);
+                } else {
+                    Deque copy(d, allocator);
+                    clear();
+                    trimSpareChunks();
+                    takeOver(copy);
+                }
+            }
+            return *this;
+        }
+
+        /**
+         * @brief забирает чанки d за O(1), если аллокатор передается или аллокаторы равны; иначе переносит элементы по одному
+         */
+        Deque& operator =(Deque&& d) noexcept(
+            AllocatorTraits::propagate_on_container_move_assignment::value ||
+            AllocatorTraits::is_always_equal::value
+        ) {
+            if(this == &d) {
+                return *this;
+            }
+            clear();
+            trimSpareChunks();
+            if constexpr(!AllocatorTraits::propagate_on_container_move_assignment::value) {
+                if(!(allocator == d.allocator)) {
+                    // память чанков d принадлежит чужому аллокатору
+                    chunkCapacity = d.chunkCapacity;
+                    maxChunkCapacity = d.maxChunkCapacity;
+                    maxSpareChunks = d.maxSpareChunks;
+                    appendRange(std::make_move_iterator(d.begin()), d.size());
+                    d.clear();
+                    return *this;
+                }
+            } else {
+                allocator = d.allocator;
+            }
+            takeOver(d);
+            return *this;
+        }
+
+        ~Deque() {
+            for(size_t i=0; i<chunks.size(); i++) {
+                destroyChunk(chunks[i]);
+            }
+            trimSpareChunks();
+        }
+
+        /**
+         * @brief обменивается содержимым с d за O(1); аллокаторы меняются местами, только если они передаются при обмене
+         */
+        void swap(Deque& d) noexcept {
+            using std::swap;
+            if constexpr(AllocatorTraits::propagate_on_container_swap::value) {
+                swap(allocator, d.allocator);
+            }
+            swap(static_cast<Stats&>(*this), static_cast<Stats&>(d));
+            swap(chunkCapacity, d.chunkCapacity);
+            swap(maxChunkCapacity, d.maxChunkCapacity);
+            swap(leftShift, d.leftShift);
+            swap(_size, d._size);
+            swap(maxSpareChunks, d.maxSpareChunks);
+            chunks.swap(d.chunks);
+            spareChunks.swap(d.spareChunks);
+            swap(chunkLeft, d.chunkLeft);
+            swap(chunkRight, d.chunkRight);
+        }
+
+        friend void swap(Deque& lhs, Deque& rhs) noexcept {
+            lhs.swap(rhs);
+        }
+
+        allocator_type get_allocator() const {
+            return allocator;
+        }
+
+        iterator begin() {
+            if(empty()) {
+                return iterator();
+            }
+            return iterator(chunkLeft->begin(), 0, this);
+        }
+        iterator end() {
+            if(empty()) {
+                return iterator();
+            }
+            return iterator(chunkRight->end(), chunks.size()-1, this);
+        }
+
+        const_iterator begin() const {
+            if(empty()) {
+                return const_iterator();
+            }
+            return const_iterator(chunkLeft->begin(), 0, this);
+        }
+        const_iterator end() const {
+            if(empty()) {
+                return const_iterator();
+            }
+            return const_iterator(chunkRight->end(), chunks.size()-1, this);
+        }
+
+        const_iterator cbegin() const {
+            return begin();
+        }
+        const_iterator cend() const {
+            return end();
+        }
+
+        reverse_iterator rbegin() {
+            return reverse_iterator(end());
+        }
+        reverse_iterator rend() {
+            return reverse_iterator(begin());
+        }
+
+        const_reverse_iterator rbegin() const {
+            return const_reverse_iterator(end());
+        }
+        const_reverse_iterator rend() const {
+            return const_reverse_iterator(begin());
+        }
+
+        template <typename... Args>
+        T& emplace_front(Args&&... args) {
+            if(!empty() && chunkLeft->full_left() && targetChunkCapacity(1) != getChunkCapacity()) {
+                // аргументы могут ссылаться на элементы, которые переедут при переупаковке
+                T value(std::forward<Args>(args)...);
+                growChunkCapacity(1);
+                return emplace_front(std::move(value));
+            }
+            if(empty() || chunkLeft->full_left()) {
+                chunks.reserve(chunks.size()+1);
+                ChunkType* chunk = createChunk();
+                try {
+                    chunk->emplace_back(std::forward<Args>(args)...);
+                } catch(...) {
+                    retireChunk(chunk);
+                    throw;
+                }
+                addChunkToFront(chunk);
+                leftShift = getChunkCapacity()-1;
+            } else {
+                chunkLeft->emplace_front(std::forward<Args>(args)...);
+                leftShift--;
+            }
+            growSize(1);
+            return *chunkLeft->begin();
+        }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            if(!empty() && chunkRight->full_right() && targetChunkCapacity(1) != getChunkCapacity()) {
+                T value(std::forward<Args>(args)...);
+                growChunkCapacity(1);
+                return emplace_back(std::move(value));
+            }
+            if(empty() || chunkRight->full_right()) {
+                chunks.reserve(chunks.size()+1);
+                ChunkType* chunk = createChunk();
+                try {
+                    chunk->emplace_front(std::forward<Args>(args)...);
+                } catch(...) {
+                    retireChunk(chunk);
+                    throw;
+                }
+                addChunkToBack(chunk);
+            } else {
+                chunkRight->emplace_back(std::forward<Args>(args)...);
+            }
+            growSize(1);
+            return *chunkRight->rbegin();
+        }
+
+        void push_front(const T& value) {
+            emplace_front(value);
+        }
+
+        void push_front(T&& value) {
+            emplace_front(std::move(value));
+        }
+
+        void push_back(const T& value) {
+            emplace_back(value);
+        }
+
+        void push_back(T&& value) {
+            emplace_back(std::move(value));
+        }
+
+        /**
+         * @brief добавляет элементы диапазона в конец дека
+         *
+         * Для однонаправленных итераторов заполняет каждый чанк одним копированием.
+         */
+        template <typename InputIt>
+        void append(InputIt first, InputIt last) {
+            using Category = typename std::iterator_traits<InputIt>::iterator_category;
+            if constexpr(std::is_base_of_v<std::forward_iterator_tag, Category>) {
+                appendRange(first, static_cast<size_t>(std::distance(first, last)));
+            } else {
+                for(; first != last; ++first) {
+                    emplace_back(*first);
+                }
+            }
+        }
+
+        void append(const T* values, size_t count) {
+            appendRange(values, count);
+        }
+
+        /**
+         * @brief добавляет в конец count элементов, байты которых записывает fill(first, last) прямо в память чанков
+         *
+         * fill вызывается по разу на каждый затронутый чанк. Только для тривиально копируемых T.
+         * Если fill бросает исключение, в деке остаются только элементы, заполненные предыдущими вызовами fill.
+         */
+        template <typename F>
+        void append_uninitialized(size_t count, F fill) {
+            if(count == 0) {
+                return;
+            }
+            growChunkCapacity(count);
+
+            if(!empty() && !chunkRight->full_right()) {
+                const size_t portion = std::min(count, chunkRight->space_back());
+                T* first = chunkRight->extend_back(portion);
+                try {
+                    fill(first, first+portion);
+                } catch(...) {
+                    chunkRight->pop_back_n(portion);
+                    throw;
+                }
+                growSize(portion);
+                count -= portion;
+            }
+
+            const size_t capacity = getChunkCapacity();
+            chunks.reserve(chunks.size()+(count+capacity-1)/capacity);
+
+            while(count) {
+                const size_t portion = std::min(count, capacity);
+                ChunkType* chunk = createChunk();
+                try {
+                    T* first = chunk->extend_back(portion);
+                    fill(first, first+portion);
+                } catch(...) {
+                    chunk->clear();
+                    retireChunk(chunk);
+                    throw;
+                }
+                addChunkToBack(chunk);
+                growSize(portion);
+                count -= portion;
+            }
+        }
+
+        /**
+         * @brief добавляет элементы диапазона в начало дека, сохраняя их порядок
+         */
+        template <typename InputIt>
+        void prepend(InputIt first, InputIt last) {
+            using Category = typename std::iterator_traits<InputIt>::iterator_category;
+            if constexpr(std::is_base_of_v<std::forward_iterator_tag, Category>) {
+                prependRange(first, static_cast<size_t>(std::distance(first, last)));
+            } else {
+                std::vector<T> buffer(first, last);
+                prependRange(std::make_move_iterator(buffer.begin()), buffer.size());
+            }
+        }
+
+        void prepend(const T* values, size_t count) {
+            prependRange(values, count);
+        }
+
+#if __cplusplus > 201703L
+        void append(std::span<const T> values) {
+            appendRange(values.data(), values.size());
+        }
+
+        void prepend(std::span<const T> values) {
+            prependRange(values.data(), values.size());
+        }
+#endif
+
+        /**
+         * @brief заменяет содержимое дека элементами диапазона
+         */
+        template <typename InputIt>
+        void assign(InputIt first, InputIt last) {
+            clear();
+            append(first, last);
+        }
+
+        void assign(const T* values, size_t count) {
+            clear();
+            appendRange(values, count);
+        }
+
+        /**
+         * @brief удаляет все элементы за O(количества чанков) для тривиально разрушаемых типов
+         *
+         * Освободившиеся чанки откладываются в запас в пределах getMaxSpareChunks(),
+         * остальные освобождаются. Если keepChunks равен true, в запас уходят все чанки,
+         * и их можно вернуть системе через trimSpareChunks().
+         */
+        void clear(bool keepChunks = false) {
+            if(keepChunks) {
+                // место в запасе резервируется до того, как чанки начнут покидать дек
+                spareChunks.reserve(spareChunks.size()+chunks.size());
+            }
+            while(!chunks.empty()) {
+                ChunkType* chunk = chunks.back();
+                chunks.pop_back();
+                chunk->clear();
+                if(keepChunks) {
+                    spareChunks.push_back(chunk);
+                } else {
+                    retireChunk(chunk);
+                }
+            }
+            chunkLeft = chunkRight = nullptr;
+            leftShift = 0;
+            _size = 0;
+        }
+
+        void pop_front() {
+            chunkLeft->pop_front();
+            if(chunkLeft->empty()) {
+                removeChunkFromFront();
+                leftShift = 0;
+            } else {
+                ++leftShift;
+            }
+            _size--;
+        }
+
+        void pop_back() {
+            chunkRight->pop_back();
+            if(chunkRight->empty()) {
+                removeChunkFromBack();
+            }
+            _size--;
+        }
+
+        /**
+         * @brief удаляет count первых элементов, освобождая опустевшие чанки целиком
+         *
+         * count не должен превышать size().
+         */
+        void pop_front_n(size_t count) {
+            _size -= count;
+            while(count) {
+                const size_t portion = std::min(count, chunkLeft->size());
+                chunkLeft->pop_front_n(portion);
+                count -= portion;
+                if(chunkLeft->empty()) {
+                    removeChunkFromFront();
+                    leftShift = 0;
+                } else {
+                    leftShift += portion;
+                }
+            }
         }
 
-    protected:
-        size_t capacity;
-        T* data;
-        T* _head;
-        T* _end;
-    };
-
-    template <typename T>
-    class ChunkPtrVector {
-    public:
-        ChunkPtrVector(): shiftLeft(0) {
+        /**
+         * @brief удаляет count последних элементов, освобождая опустевшие чанки целиком
+         *
+         * count не должен превышать size().
+         */
+        void pop_back_n(size_t count) {
+            _size -= count;
+            while(count) {
+                const size_t portion = std::min(count, chunkRight->size());
+                chunkRight->pop_back_n(portion);
+                count -= portion;
+                if(chunkRight->empty()) {
+                    removeChunkFromBack();
+                }
+            }
+            if(!_size) {
+                leftShift = 0;
+            }
+        }
 
+        /**
+         * @brief перемещает не больше count первых элементов в output и удаляет их из дека
+         *
+         * Элементы каждого чанка перемещаются одним вызовом std::move.
+         */
+        template <typename OutputIt>
+        OutputIt drain_front(size_t count, OutputIt output) {
+            count = std::min(count, _size);
+            while(count) {
+                const size_t portion = std::min(count, chunkLeft->size());
+                output = std::move(chunkLeft->begin(), chunkLeft->begin()+portion, output);
+                pop_front_n(portion);
+                count -= portion;
+            }
+            return output;
         }
 
-        Chunk<T>* operator [](size_t index) const {
-            return data[index+shiftLeft];
+        /**
+         * @brief перемещает не больше count первых элементов в буфер destination
+         *
+         * Возвращает количество перемещенных элементов.
+         */
+        size_t drain_front(T* destination, size_t count) {
+            count = std::min(count, _size);
+            drain_front(count, destination);
+            return count;
         }
 
-        Chunk<T>* front() {
-            return data[shiftLeft];
+#if __cplusplus > 201703L
+        size_t drain_front(std::span<T> destination) {
+            return drain_front(destination.data(), destination.size());
         }
+#endif
 
-        Chunk<T>* back() {
-            return data.back();
+        /**
+         * @brief вставляет value перед pos; возвращает итератор на вставленный элемент
+         *
+         * Сдвигает элементы к ближайшему концу, поэтому перемещает min(i, size()-i) элементов.
+         * Делает недействительными все итераторы. Ссылки на элементы остаются действительными,
+         * только если pos указывает на начало или конец дека.
+         */
+        iterator insert(const_iterator pos, const T& value) {
+            T copy(value);
+            return insert(pos, std::make_move_iterator(&copy), std::make_move_iterator(&copy+1));
         }
 
-        void push_back(Chunk<T>* chunk) {
-            data.push_back(chunk);
+        iterator insert(const_iterator pos, T&& value) {
+            return insert(pos, std::make_move_iterator(&value), std::make_move_iterator(&value+1));
         }
 
-        void push_front(Chunk<T>* chunk) {
-            if(shiftLeft == 0) {
-                throw std::out_of_range("...");
+        /**
+         * @brief вставляет элементы диапазона перед pos; возвращает итератор на первый вставленный
+         *
+         * Под вставку у ближайшего конца добавляются целые чанки, и сдвигается
+         * не больше min(i, size()-i) существующих элементов. Правила недействительности
+         * итераторов и ссылок те же, что у вставки одного элемента.
+         * Диапазон не должен указывать на элементы этого дека.
+         */
+        template <typename InputIt>
+        iterator insert(const_iterator pos, InputIt first, InputIt last) {
+            using Category = typename std::iterator_traits<InputIt>::iterator_category;
+            const size_t index = pos-cbegin();
+            if constexpr(std::is_base_of_v<std::forward_iterator_tag, Category>) {
+                insertRange(index, first, static_cast<size_t>(std::distance(first, last)));
+            } else {
+                std::vector<T> buffer(first, last);
+                insertRange(index, std::make_move_iterator(buffer.begin()), buffer.size());
             }
-            data[--shiftLeft] = chunk;
+            return begin()+index;
         }
 
-        bool can_push_front() const {
-            return shiftLeft != 0;
+        /**
+         * @brief удаляет элемент pos; возвращает итератор на следующий за ним
+         *
+         * Сдвигает элементы с ближайшего конца. Делает недействительными все итераторы
+         * и ссылки, кроме ссылок на неудаленные элементы при удалении первого или последнего элемента.
+         */
+        iterator erase(const_iterator pos) {
+            return erase(pos, pos+1);
         }
 
-        void pop_back() {
-            data.pop_back();
+        /**
+         * @brief удаляет элементы [first, last); возвращает итератор на следующий за удаленными
+         *
+         * Перемещает min(элементов до first, элементов после last) элементов,
+         * а освободившиеся чанки у конца убирает целиком.
+         */
+        iterator erase(const_iterator first, const_iterator last) {
+            const size_t index = first-cbegin();
+            const size_t count = last-first;
+            if(count == 0) {
+                return begin()+index;
+            }
+
+            if(index < _size-index-count) {
+                moveBackward(0, count, index);
+                pop_front_n(count);
+            } else {
+                moveForward(index+count, index, _size-index-count);
+                pop_back_n(count);
+            }
+            return begin()+index;
         }
 
-        void pop_front() {
-            ++shiftLeft;
+        T& operator [](size_t i) {
+            return getElementByIndex(i);
         }
 
-        size_t shift() const {
-            return shiftLeft;
+        const T& operator [](size_t i) const {
+            return getElementByIndex(i);
         }
 
         size_t size() const {
-            return data.size()-shiftLeft;
+            return _size;
         }
 
         bool empty() const {
-            return !size();
-        }
-
-        friend std::ostream& operator <<(std::ostream& stream, const ChunkPtrVector<T>& d) {
-            return stream << "SIZE: " << d.size() << ", FRONT: " << d.indexFront;
+            return !_size;
         }
 
-    protected:
-        std::vector< Chunk<T>* > data;
-        size_t shiftLeft;
-    };
-
-    template <typename T>
-    class Deque {
-    public:
-        class iterator;
-        friend class iterator;
-        class const_iterator;
-        friend class const_iterator;
-
-        explicit Deque(size_t chunkCapacity):
-            chunkCapacity(chunkCapacity),
-            leftShift(0),
-            _size(0)
-        {}
-
-        iterator begin() {
-            return iterator(data.begin()->begin(), data.begin(), this, 0);
-        }
-        iterator end() {
-            return iterator(data.rbegin()->end(), --data.end(), this, size());
+        size_t chunksCount() const {
+            return chunks.size();
         }
 
-        const const_iterator begin() const {
-            return const_iterator(data.begin()->begin(), data.begin(), this, 0);
-        }
-        const const_iterator end() const {
-            return const_iterator(data.rbegin()->end(), --data.end(), this, size());
+        /**
+         * @brief возвращает непрерывный диапазон элементов i-го чанка
+         */
+        Segment<T> segment(size_t i) {
+            return {chunks[i]->begin(), chunks[i]->end()};
         }
 
-        iterator rbegin() {
-            return iterator(data.rbegin()->rbegin(), --data.end(), this, size()-1);
-        }
-        iterator rend() {
-            return iterator(data.begin()->rend(), data.begin(), this, -1);
+        Segment<const T> segment(size_t i) const {
+            return {chunks[i]->begin(), chunks[i]->end()};
         }
 
-        const iterator rbegin() const {
-            return iterator(data.rbegin()->rbegin(), --data.end(), this, size()-1);
-        }
-        const iterator rend() const {
-            return iterator(data.rbegin()->rbegin(), --data.end(), this, -1);
+        /**
+         * @brief вызывает f(first, last) для непрерывного диапазона каждого чанка, от первого к последнему
+         */
+        template <typename F>
+        void for_each_segment(F f) {
+            for(size_t i=0; i<chunks.size(); i++) {
+                f(chunks[i]->begin(), chunks[i]->end());
+            }
         }
 
-        void push_front(const T& value) {
-            if(empty() || chunkLeft->full_left()) {
-                addChunkToFront(createChunk(data.begin()));
-                chunkLeft->push_back(value);
-                leftShift = chunkCapacity-1;
-            } else {
-                chunkLeft->push_front(value);
-                leftShift--;
+        template <typename F>
+        void for_each_segment(F f) const {
+            for(size_t i=0; i<chunks.size(); i++) {
+                const ChunkType* chunk = chunks[i];
+                f(chunk->begin(), chunk->end());
             }
-            _size++;
         }
 
-        void push_back(const T& value) {
-            if(empty() || chunkRight->full_right()) {
-                addChunkToBack(createChunk(data.end()));
-                chunkRight->push_front(value);
-            } else if(chunkRight->empty()) {
-                chunkRight->push_front(value);
+        size_t getChunkCapacity() const {
+            if constexpr(ChunkCapacity != 0) {
+                return ChunkCapacity;
             } else {
-                chunkRight->push_back(value);
+                return chunkCapacity;
             }
-            _size++;
         }
 
-        void pop_front() {
-            chunkLeft->pop_front();
-            if(chunkLeft->empty()) {
-                removeChunkFromFront();
-                leftShift = 0;
-            } else {
-                ++leftShift;
-            }
-            _size--;
+        /**
+         * @brief возвращает количество освободившихся чанков, ожидающих повторного использования
+         */
+        size_t spareChunksCount() const {
+            return spareChunks.size();
         }
 
-        void pop_back() {
-            chunkRight->pop_back();
-            if(chunkRight->empty()) {
-                removeChunkFromBack();
-            }
-            _size--;
+        size_t getMaxSpareChunks() const {
+            return maxSpareChunks;
         }
 
-        T& operator [](const size_t& i) const {
-            return getElementByIndex(i);
+        /**
+         * @brief задает, сколько освободившихся чанков можно держать для повторного использования
+         *
+         * Для очереди FIFO достаточно одного чанка; см. defaultMaxSpareChunks о том, когда запас нужен.
+         */
+        void setMaxSpareChunks(size_t count) {
+            maxSpareChunks = count;
+            trimSpareChunks(count);
         }
 
-        size_t size() const {
-            return _size;
+        /**
+         * @brief освобождает память запасных чанков, оставляя не больше count штук
+         */
+        void trimSpareChunks(size_t count = 0) {
+            while(spareChunks.size() > count) {
+                destroyChunk(spareChunks.back());
+                spareChunks.pop_back();
+            }
         }
 
-        bool empty() const {
-            return !_size;
+        /**
+         * @brief готовит память под count элементов перед первым, чтобы следующие count вызовов push_front не обращались к аллокатору
+         *
+         * Недостающие чанки создаются заранее и ждут в запасе, индекс чанков расширяется под них.
+         * Запас общий для обоих концов, поэтому из двух резервирований, reserve_front и reserve_back,
+         * гарантируется только большее по количеству чанков.
+         */
+        void reserve_front(size_t count) {
+            reserveChunks(count, true);
         }
 
-        size_t chunksCount() const {
-            return data.size();
+        /**
+         * @brief готовит память под count элементов после последнего, чтобы следующие count вызовов push_back не обращались к аллокатору
+         */
+        void reserve_back(size_t count) {
+            reserveChunks(count, false);
         }
 
-        void printClusterSizes() {
-            std::cout << "CLUSTER SIZES: ";
-            for(const auto& c : data) {
-                std::cout << c.size() << ", ";
-            }
-            std::cout << std::endl;
+        /**
+         * @brief освобождает запасные чанки и сжимает индекс чанков до нужного размера
+         */
+        void shrink_to_fit() {
+            trimSpareChunks();
+            spareChunks.shrink_to_fit();
+            chunks.shrink_to_fit();
         }
 
         void printData() const {
             std::cout << std::endl;
 
-            long int i = getLeftChunkIndex();
-            for(auto& chunk : data) {
-                std::cout << i++ << ": ";
-                chunk.printData();
+            for(size_t i=0; i<chunks.size(); i++) {
+                std::cout << i << ": ";
+                chunks[i]->printData();
             }
 
             std::cout << std::endl;
         }
 
-        void printDataVerbose() const {
-            std::cout << "SIZE: " << size() << std::endl;
-            std::cout << "LEFT SHIFT: " << getLeftShift() << std::endl;
-            std::cout << "CLUSTERS COUNT: " << data.size() << " | " << (partLeft.size()+partRight.size()) << std::endl;
-            std::cout << "{";
-            for(size_t i=0; i<size(); i++) {
-                std::cout << (*this)[i] << ", ";
+        /**
+         * @brief возвращает статистику дека; счетчики событий ненулевые только с политикой CountingDequeStats
+         */
+        DequeStats stats() const {
+            DequeStats result;
+            Stats::collect(result);
+            chunks.getStats().collect(result);
+
+            result.size = _size;
+            result.chunks = chunks.size();
+            result.spareChunks = spareChunks.size();
+            result.chunkCapacity = getChunkCapacity();
+            result.indexCapacity = chunks.capacity();
+            result.leftShift = leftShift;
+            result.liveBytes = _size*sizeof(T);
+
+            size_t chunkBytes = sizeof(ChunkType);
+            if constexpr(ChunkCapacity == 0) {
+                chunkBytes += chunkCapacity*sizeof(T);
+            }
+            result.residentBytes = (chunks.size()+spareChunks.size())*chunkBytes+chunks.capacity()*sizeof(ChunkType*);
+            return result;
+        }
+
+        /**
+         * @brief возвращает статистику вместе с количеством элементов в каждом чанке
+         */
+        DequeReport report() const {
+            DequeReport result;
+            result.stats = stats();
+            result.chunkSizes.reserve(chunks.size());
+            for(size_t i=0; i<chunks.size(); i++) {
+                result.chunkSizes.push_back(chunks[i]->size());
             }
-            std::cout << "}" << std::endl;
-            printData();
-            std::cout << "==========" << std::endl << std::endl;
+            return result;
         }
 
         size_t getLeftShift() const {
             return leftShift;
         }
 
-        friend std::ostream& operator <<(std::ostream& stream, Deque<T> d) {
-            return stream << d.data;
+        friend std::ostream& operator <<(std::ostream& stream, const Deque& d) {
+            stream << "[";
+            for(size_t i=0; i<d.chunks.size(); i++) {
+                if(i) {
+                    stream << ", ";
+                }
+                stream << *d.chunks[i];
+            }
+            return stream << "]";
         }
 
     protected:
+        using AllocatorTraits = std::allocator_traits<Allocator>;
+        using ChunkAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ChunkType>;
+        using ChunkAllocatorTraits = std::allocator_traits<ChunkAllocator>;
+        using PointerAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ChunkType*>;
+
+        Allocator allocator;
         size_t chunkCapacity;
+        size_t maxChunkCapacity;
         size_t leftShift;
         size_t _size;
+        size_t maxSpareChunks;
 
-        std::list< Chunk<T> > data;
+        ChunkMap<T, ChunkCapacity, Allocator, Stats> chunks;
+        std::vector< ChunkType*, PointerAllocator > spareChunks;
 
-        ChunkPtrVector<T> partLeft;
-        ChunkPtrVector<T> partRight;
+        ChunkType* chunkLeft = nullptr;
+        ChunkType* chunkRight = nullptr;
 
-        Chunk<T>* chunkLeft = nullptr;
-        Chunk<T>* chunkRight = nullptr;
+        /**
+         * @brief возвращает номер чанка для позиции, отсчитанной от начала самого левого чанка
+         */
+        size_t getChunkOffset(size_t position) const {
+            if constexpr(ChunkCapacity != 0) {
+                return position >> log2PowerOfTwo(ChunkCapacity);
+            } else {
+                return position / chunkCapacity;
+            }
+        }
 
         /**
-         * @brief возвращает индекс самого левого чанка
+         * @brief возвращает индекс элемента внутри чанка для позиции, отсчитанной от начала самого левого чанка
          */
-        int getLeftChunkIndex() const {
-            if(partLeft.empty()) {
-                return static_cast<long int>(partRight.shift());
+        size_t getItemOffset(size_t position) const {
+            if constexpr(ChunkCapacity != 0) {
+                return position & (ChunkCapacity-1);
+            } else {
+                return position % chunkCapacity;
             }
-            return -static_cast<long int>(partLeft.size());
         }
 
         T& getElementByIndex(const size_t& index) const {
-            int leftChunkIndex = getLeftChunkIndex();
-            int chunkShift = static_cast<long int>((index+leftShift)/chunkCapacity) + leftChunkIndex;
-            size_t chunkIndex;
-            size_t itemIndex = (index+leftShift)%chunkCapacity;
+            const size_t position = index+leftShift;
+            return (*chunks[getChunkOffset(position)])[getItemOffset(position)];
+        }
+
+        template <typename ForwardIt>
+        void appendRange(ForwardIt first, size_t count) {
+            if(count == 0) {
+                return;
+            }
+            growChunkCapacity(count);
+
+            if(!empty() && !chunkRight->full_right()) {
+                const size_t portion = std::min(count, chunkRight->space_back());
+                first = chunkRight->fill_back(first, portion);
+                growSize(portion);
+                count -= portion;
+            }
+
+            const size_t capacity = getChunkCapacity();
+            chunks.reserve(chunks.size()+(count+capacity-1)/capacity);
+
+            while(count) {
+                const size_t portion = std::min(count, capacity);
+                ChunkType* chunk = createChunk();
+                try {
+                    first = chunk->fill_back(first, portion);
+                } catch(...) {
+                    retireChunk(chunk);
+                    throw;
+                }
+                addChunkToBack(chunk);
+                growSize(portion);
+                count -= portion;
+            }
+        }
+
+        /**
+         * @brief добавляет count элементов в начало дека
+         *
+         * Новые чанки заполняются слева направо и подключаются только после того,
+         * как скопированы все элементы, поэтому при исключении дек не меняется.
+         */
+        template <typename ForwardIt>
+        void prependRange(ForwardIt first, size_t count) {
+            if(count == 0) {
+                return;
+            }
+            growChunkCapacity(count);
+            if(empty()) {
+                appendRange(first, count);
+                return;
+            }
+
+            const size_t capacity = getChunkCapacity();
+            const size_t freeLeft = chunkLeft->space_front();
+            const size_t newChunksCount = count > freeLeft ? (count-freeLeft+capacity-1)/capacity : 0;
+
+            chunks.reserve(chunks.size()+newChunksCount);
+            std::vector< ChunkType*, PointerAllocator > newChunks(allocator);
+            newChunks.reserve(newChunksCount);
+
+            try {
+                size_t rest = count;
+                for(size_t i=0; i<newChunksCount; i++) {
+                    newChunks.push_back(createChunk());
+                    const size_t portion = i ? capacity : count-freeLeft-(newChunksCount-1)*capacity;
+                    first = newChunks.back()->fill_front(first, portion);
+                    rest -= portion;
+                }
+                chunkLeft->fill_front(first, rest);
+            } catch(...) {
+                for(ChunkType* chunk : newChunks) {
+                    chunk->clear();
+                    retireChunk(chunk);
+                }
+                throw;
+            }
 
-            if(chunkShift >= 0) {
-                chunkIndex = static_cast<size_t>(chunkShift);
-                return (*(partRight[chunkIndex-partRight.shift()]))[itemIndex];
+            for(size_t i=newChunksCount; i>0; i--) {
+                addChunkToFront(newChunks[i-1]);
             }
+            leftShift = chunkLeft->begin()-chunkLeft->getData();
+            growSize(count);
+        }
 
-            chunkIndex = static_cast<size_t>(-chunkShift-1);
-            return (*(partLeft[chunkIndex-partLeft.shift()]))[itemIndex];
+        /**
+         * @brief вставляет count элементов из first перед элементом с номером index
+         *
+         * Если index ближе к началу, в начало добавляются count мест, элементы [0, index)
+         * переезжают на count позиций влево, и в освободившиеся места записываются новые элементы.
+         * Иначе то же самое делается с концом.
+         */
+        template <typename ForwardIt>
+        void insertRange(size_t index, ForwardIt first, size_t count) {
+            if(count == 0) {
+                return;
+            }
+            // до того, как appendRange и prependRange получат итераторы на элементы дека
+            growChunkCapacity(count);
+
+            if(index < _size-index) {
+                if(index >= count) {
+                    prependRange(std::make_move_iterator(begin()), count);
+                    moveForward(2*count, count, index-count);
+                    std::copy_n(first, count, begin()+index);
+                } else {
+                    ForwardIt middle = std::next(first, count-index);
+                    prependRange(first, count-index);
+                    prependRange(std::make_move_iterator(begin()+(count-index)), index);
+                    std::copy_n(middle, index, begin()+count);
+                }
+            } else {
+                const size_t oldSize = _size;
+                const size_t after = oldSize-index;
+                if(after >= count) {
+                    appendRange(std::make_move_iterator(begin()+(oldSize-count)), count);
+                    moveBackward(index, index+count, after-count);
+                    std::copy_n(first, count, begin()+index);
+                } else {
+                    appendRange(std::next(first, after), count-after);
+                    appendRange(std::make_move_iterator(begin()+index), after);
+                    std::copy_n(first, after, begin()+index);
+                }
+            }
         }
 
-        void addChunkToFront(Chunk<T>* chunk) {
-            if(partRight.can_push_front()) {
-                partRight.push_front(chunk);
+        /**
+         * @brief возвращает вместимость чанка, нужную для size()+extra элементов
+         *
+         * Совпадает с текущей, если вместимость не растет или расти пока рано.
+         */
+        size_t targetChunkCapacity(size_t extra) const {
+            if constexpr(ChunkCapacity != 0) {
+                return ChunkCapacity;
             } else {
-                partLeft.push_back(chunk);
+                size_t capacity = chunkCapacity;
+                while(capacity < maxChunkCapacity && _size+extra > capacity*adaptiveChunksCount) {
+                    capacity *= 2;
+                }
+                return std::min(capacity, maxChunkCapacity);
+            }
+        }
+
+        void growChunkCapacity(size_t extra) {
+            if constexpr(ChunkCapacity == 0) {
+                const size_t capacity = targetChunkCapacity(extra);
+                if(capacity != chunkCapacity) {
+                    repack(capacity);
+                }
+            }
+        }
+
+        /**
+         * @brief переносит все элементы в чанки вместимости newCapacity, начиная с начала первого чанка
+         *
+         * Элементы перемещаются, если перемещение не бросает исключений, иначе копируются,
+         * поэтому при исключении дек остается прежним.
+         */
+        void repack(size_t newCapacity) {
+            trimSpareChunks();
+
+            const size_t oldCapacity = chunkCapacity;
+            std::vector< ChunkType*, PointerAllocator > newChunks(allocator);
+            chunkCapacity = newCapacity;
+            try {
+                const size_t newChunksCount = (_size+newCapacity-1)/newCapacity;
+                newChunks.reserve(newChunksCount);
+                for(size_t i=0; i<newChunksCount; i++) {
+                    newChunks.push_back(createChunk());
+                }
+
+                size_t target = 0;
+                for(size_t i=0; i<chunks.size(); i++) {
+                    T* first = chunks[i]->begin();
+                    size_t count = chunks[i]->size();
+                    while(count) {
+                        ChunkType* chunk = newChunks[target];
+                        const size_t portion = std::min(count, chunk->space_back());
+                        if constexpr(std::is_trivially_copyable_v<T> || !std::is_nothrow_move_constructible_v<T>) {
+                            chunk->fill_back(static_cast<const T*>(first), portion);
+                        } else {
+                            chunk->fill_back(std::make_move_iterator(first), portion);
+                        }
+                        first += portion;
+                        count -= portion;
+                        if(chunk->full_right()) {
+                            target++;
+                        }
+                    }
+                }
+            } catch(...) {
+                for(ChunkType* chunk : newChunks) {
+                    chunk->clear();
+                    destroyChunk(chunk);
+                }
+                chunkCapacity = oldCapacity;
+                throw;
             }
+
+            // новых чанков не больше, чем старых, поэтому индекс чанков не перевыделяется
+            while(!chunks.empty()) {
+                destroyChunk(chunks.back());
+                chunks.pop_back();
+            }
+            for(ChunkType* chunk : newChunks) {
+                chunks.push_back(chunk);
+            }
+            chunkLeft = chunks.empty() ? nullptr : chunks.front();
+            chunkRight = chunks.empty() ? nullptr : chunks.back();
+            leftShift = 0;
+            Stats::onRepacked();
+        }
+
+        /**
+         * @brief перемещает count элементов с номера from на номер to < from, по участкам внутри чанков
+         */
+        void moveForward(size_t from, size_t to, size_t count) {
+            const size_t capacity = getChunkCapacity();
+            while(count) {
+                const size_t fromOffset = getItemOffset(from+leftShift);
+                const size_t toOffset = getItemOffset(to+leftShift);
+                const size_t portion = std::min(count, capacity-std::max(fromOffset, toOffset));
+                T* source = &getElementByIndex(from);
+                std::move(source, source+portion, &getElementByIndex(to));
+                from += portion;
+                to += portion;
+                count -= portion;
+            }
+        }
+
+        /**
+         * @brief перемещает count элементов с номера from на номер to > from, начиная с последнего
+         */
+        void moveBackward(size_t from, size_t to, size_t count) {
+            while(count) {
+                const size_t fromOffset = getItemOffset(from+count-1+leftShift);
+                const size_t toOffset = getItemOffset(to+count-1+leftShift);
+                const size_t portion = std::min(count, std::min(fromOffset, toOffset)+1);
+                T* sourceEnd = &getElementByIndex(from+count-1)+1;
+                std::move_backward(sourceEnd-portion, sourceEnd, &getElementByIndex(to+count-1)+1);
+                count -= portion;
+            }
+        }
+
+        void addChunkToFront(ChunkType* chunk) {
+            chunks.push_front(chunk);
+            Stats::onChunkAdded(chunks.size());
             chunkLeft = chunk;
             if(chunkRight == nullptr) {
                 chunkRight = chunk;
             }
         }
 
-        void addChunkToBack(Chunk<T>* chunk) {
-            if(partLeft.can_push_front()) {
-                partLeft.push_front(chunk);
-            } else {
-                partRight.push_back(chunk);
-            }
+        void addChunkToBack(ChunkType* chunk) {
+            chunks.push_back(chunk);
+            Stats::onChunkAdded(chunks.size());
             chunkRight = chunk;
             if(chunkLeft == nullptr) {
                 chunkLeft = chunk;
+                leftShift = 0;
             }
         }
 
         void removeChunkFromFront() {
-            data.pop_front();
-            if(!partLeft.empty()) {
-                partLeft.pop_back();
-            } else {
-                partRight.pop_front();
-            }
+            retireChunk(chunks.front());
+            chunks.pop_front();
 
-            if(!partLeft.empty()) {
-                chunkLeft = partLeft.back(); // было front
-            } else if(!partRight.empty()) {
-                chunkLeft = partRight.front();
+            if(!chunks.empty()) {
+                chunkLeft = chunks.front();
             } else {
                 chunkLeft = chunkRight = nullptr;
             }
         }
 
         void removeChunkFromBack() {
-            data.pop_back();
-            if(!partRight.empty()) {
-                partRight.pop_back();
-            } else {
-                partLeft.pop_front();
-            }
+            retireChunk(chunks.back());
+            chunks.pop_back();
 
-            if(!partRight.empty()) {
-                chunkRight = partRight.back();
-            } else if(!partLeft.empty()) {
-                chunkRight = partLeft.front(); // было back
+            if(!chunks.empty()) {
+                chunkRight = chunks.back();
             } else {
                 chunkLeft = chunkRight = nullptr;
             }
         }
 
-        Chunk<T>* createChunk(const typename std::list< Chunk<T> >::iterator position) {
-            const auto& p = data.insert(position, std::move(Chunk<T>(chunkCapacity)));
-            return &(*p);
-        }
-    };
-
-    template <typename T>
-    class Deque<T>::iterator : public std::iterator<std::random_access_iterator_tag, T, ptrdiff_t> {
-    public:
         /**
-         * @brief конструктор по умолчанию
+         * @brief убирает чанк из дека, по возможности сохраняя его в запас
+         *
+         * Не бросает исключений: если запасу не хватает памяти на еще один указатель,
+         * чанк освобождается, и дек остается согласованным.
          */
-        iterator(T* ptr, const typename std::list< Chunk<T> >::iterator& chunkIt, Deque<T>* container, size_t index):
-            ptr(ptr), chunkIt(chunkIt), container(container), index(index) {}
-
-        bool operator==(const iterator& x) const {
-            return ptr == x.ptr;
-        }
-        bool operator!=(const iterator& x) const {
-            return !(*this == x);
-        }
-        T& operator*() {
-            return *ptr;
+        void retireChunk(ChunkType* chunk) noexcept {
+            if(spareChunks.size() < maxSpareChunks) {
+                try {
+                    spareChunks.push_back(chunk);
+                    return;
+                } catch(...) {}
+            }
+            destroyChunk(chunk);
         }
-        iterator& operator++() {
-            ptr++;
-            index++;
 
-            if(ptr == getEndPtr()) {
-                return *this;
+        /**
+         * @brief кладет в запас столько новых чанков, чтобы count элементов поместились у начала или у конца дека
+         */
+        void reserveChunks(size_t count, bool front) {
+            growChunkCapacity(count);
+            const size_t free = empty() ? 0 : (front ? chunkLeft->space_front() : chunkRight->space_back());
+            if(count <= free) {
+                return;
             }
+            const size_t capacity = getChunkCapacity();
+            const size_t needed = (count-free+capacity-1)/capacity;
 
-            if(ptr == chunkIt->end()) {
-                chunkIt++;
-                ptr = chunkIt->begin();
+            chunks.reserve(chunks.size()+needed);
+            spareChunks.reserve(needed);
+            while(spareChunks.size() < needed) {
+                spareChunks.push_back(allocateChunk());
             }
-
-            return *this;
-        }
-        iterator operator++(int) {
-            iterator tmp = *this;
-            ++(*this);
-            return tmp;
         }
-        iterator& operator--() {
-            ptr--;
-            index--;
 
-            if(ptr == getRendPtr()) {
-                return *this;
+        ChunkType* createChunk() {
+            if(!spareChunks.empty()) {
+                ChunkType* chunk = spareChunks.back();
+                spareChunks.pop_back();
+                Stats::onSpareChunkReused();
+                return chunk;
             }
+            return allocateChunk();
+        }
 
-            if(ptr == chunkIt->rend()) {
-                chunkIt--;
-                ptr = chunkIt->rbegin();
+        /**
+         * @brief создает копию чанка с теми же смещениями элементов
+         */
+        ChunkType* copyChunk(const ChunkType& source) {
+            ChunkAllocator chunkAllocator(allocator);
+            ChunkType* chunk = ChunkAllocatorTraits::allocate(chunkAllocator, 1);
+            try {
+                ChunkAllocatorTraits::construct(chunkAllocator, chunk, source, allocator);
+            } catch(...) {
+                ChunkAllocatorTraits::deallocate(chunkAllocator, chunk, 1);
+                throw;
             }
-
-            return *this;
-        }
-        iterator operator--(int) {
-            iterator tmp = *this;
-            --(*this);
-            return tmp;
-        }
-        T& operator[] (const size_t i) const {
-            return (*container)[i];
+            Stats::onChunkAllocated();
+            return chunk;
         }
-    //    iterator& operator+=(int n) {
-    //        return this;
-    //    }
-    private:
-        T* ptr;
-        typename std::list< Chunk<T> >::iterator chunkIt;
-        Deque<T>* container;
-        size_t index;
-
-        T* endPtr = nullptr;
-        T* rendPtr = nullptr;
 
-        T* getEndPtr() {
-            if(endPtr == nullptr) {
-                endPtr = container->end().ptr;
+        /**
+         * @brief забирает состояние d за O(1); у дека не должно быть чанков, а аллокаторы должны быть равны
+         */
+        void takeOver(Deque& d) {
+            Stats::operator =(std::move(d));
+            chunkCapacity = d.chunkCapacity;
+            maxChunkCapacity = d.maxChunkCapacity;
+            leftShift = std::exchange(d.leftShift, 0);
+            _size = std::exchange(d._size, 0);
+            maxSpareChunks = d.maxSpareChunks;
+            chunks = std::move(d.chunks);
+            spareChunks = std::move(d.spareChunks);
+            chunkLeft = std::exchange(d.chunkLeft, nullptr);
+            chunkRight = std::exchange(d.chunkRight, nullptr);
+        }
+
+        ChunkType* allocateChunk() {
+            ChunkAllocator chunkAllocator(allocator);
+            ChunkType* chunk = ChunkAllocatorTraits::allocate(chunkAllocator, 1);
+            try {
+                ChunkAllocatorTraits::construct(chunkAllocator, chunk, chunkCapacity, allocator);
+            } catch(...) {
+                ChunkAllocatorTraits::deallocate(chunkAllocator, chunk, 1);
+                throw;
             }
-
-            return endPtr;
+            Stats::onChunkAllocated();
+            return chunk;
         }
 
-        T* getRendPtr() {
-            if(rendPtr == nullptr) {
-                rendPtr = container->data.begin()->rend();
-            }
+        void destroyChunk(ChunkType* chunk) {
+            ChunkAllocator chunkAllocator(allocator);
+            ChunkAllocatorTraits::destroy(chunkAllocator, chunk);
+            ChunkAllocatorTraits::deallocate(chunkAllocator, chunk, 1);
+            Stats::onChunkFreed();
+        }
 
-            return rendPtr;
+        void growSize(size_t count) {
+            _size += count;
+            Stats::onSizeGrown(_size);
         }
     };
 
-    template <typename T>
-    class Deque<T>::const_iterator : public std::iterator<std::random_access_iterator_tag, T, ptrdiff_t> {
+    /**
+     * @brief итератор произвольного доступа по деку
+     *
+     * Помнит номер чанка и границы его памяти, поэтому инкремент проверяет
+     * только выход за чанк, а сдвиг на n элементов выполняется за O(1).
+     * Итератор конца всегда указывает на конец последнего чанка.
+     */
+    template <typename T, size_t ChunkCapacity, typename Allocator, typename Stats>
+    template <bool IsConst>
+    class Deque<T, ChunkCapacity, Allocator, Stats>::Iterator {
+        using Container = std::conditional_t<IsConst, const Deque, Deque>;
+
     public:
-        /**
-         * @brief конструктор по умолчанию
-         */
-        const_iterator(T* ptr, const typename std::list< Chunk<T> >::iterator& chunkIt, Deque<T>* container):
-            ptr(ptr), chunkIt(chunkIt), container(container) {}
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
 
-        const_iterator(const iterator& it): const_iterator(it.ptr, it.chunkIt, it.container) {}
+        Iterator():
+            ptr(nullptr), first(nullptr), last(nullptr), chunkIndex(0), container(nullptr) {}
 
-        bool operator==(const const_iterator& x) const {
-            return ptr == x.ptr;
-        }
-        bool operator!=(const const_iterator& x) const {
-            return !(*this == x);
+        Iterator(pointer ptr, size_t chunkIndex, Container* container):
+            ptr(ptr), chunkIndex(chunkIndex), container(container)
+        {
+            setChunk(chunkIndex);
         }
-        const T& operator*() const {
+
+        template <bool WasConst, typename = std::enable_if_t<IsConst && !WasConst>>
+        Iterator(const Iterator<WasConst>& it):
+            ptr(it.ptr), first(it.first), last(it.last), chunkIndex(it.chunkIndex), container(it.container) {}
+
+        reference operator*() const {
             return *ptr;
         }
-        const_iterator& operator++() {
-            ptr++;
+        pointer operator->() const {
+            return ptr;
+        }
+        reference operator[](difference_type n) const {
+            return *(*this + n);
+        }
 
-            if(ptr == getEndPtr()) {
-                return *this;
-            }
+        Iterator& operator++() {
+            ++ptr;
 
-            if(ptr == chunkIt->end()) {
-                chunkIt++;
-                ptr = chunkIt->begin();
+            if(ptr == last && chunkIndex+1 < container->chunks.size()) {
+                setChunk(chunkIndex+1);
+                ptr = first;
             }
 
             return *this;
         }
-        const_iterator operator++(int) {
-            const_iterator tmp = *this;
+        Iterator operator++(int) {
+            Iterator tmp = *this;
             ++(*this);
             return tmp;
         }
-        const_iterator& operator--() {
-            ptr--;
-
-            if(ptr == getRendPtr()) {
-                return *this;
+        Iterator& operator--() {
+            if(ptr == first && chunkIndex > 0) {
+                setChunk(chunkIndex-1);
+                ptr = last;
             }
 
-            if(ptr == chunkIt->rend()) {
-                chunkIt--;
-                ptr = chunkIt->rbegin();
-            }
+            --ptr;
 
             return *this;
         }
-        const_iterator operator--(int) {
-            const_iterator tmp = *this;
+        Iterator operator--(int) {
+            Iterator tmp = *this;
             --(*this);
             return tmp;
         }
-    private:
-        T* ptr;
-        typename std::list< Chunk<T> >::iterator chunkIt;
-        Deque<T>* container;
 
-        T* endPtr = nullptr;
-        T* rendPtr = nullptr;
+        Iterator& operator+=(difference_type n) {
+            if(n == 0) {
+                return *this;
+            }
+
+            const size_t position = chunkIndex*container->getChunkCapacity()+(ptr-first)+n;
+            size_t newChunkIndex = container->getChunkOffset(position);
+            size_t itemIndex = container->getItemOffset(position);
 
-        T* getEndPtr() {
-            if(endPtr == nullptr) {
-                endPtr = container->end().ptr;
+            if(newChunkIndex == container->chunks.size()) {
+                // позиция сразу за полным последним чанком: это конец дека
+                --newChunkIndex;
+                itemIndex = container->getChunkCapacity();
             }
 
-            return endPtr;
+            setChunk(newChunkIndex);
+            ptr = first+itemIndex;
+
+            return *this;
+        }
+        Iterator& operator-=(difference_type n) {
+            return *this += -n;
         }
 
-        T* getRendPtr() {
-            if(rendPtr == nullptr) {
-                rendPtr = container->data.begin()->rend();
+        friend Iterator operator+(Iterator it, difference_type n) {
+            return it += n;
+        }
+        friend Iterator operator+(difference_type n, Iterator it) {
+            return it += n;
+        }
+        friend Iterator operator-(Iterator it, difference_type n) {
+            return it -= n;
+        }
+        friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+            if(lhs.container == nullptr) {
+                return 0;
             }
+            return (static_cast<difference_type>(lhs.chunkIndex)-static_cast<difference_type>(rhs.chunkIndex))
+                * static_cast<difference_type>(lhs.container->getChunkCapacity())
+                + (lhs.ptr-lhs.first) - (rhs.ptr-rhs.first);
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+            return lhs.ptr == rhs.ptr;
+        }
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) {
+            return lhs.ptr != rhs.ptr;
+        }
+        friend bool operator<(const Iterator& lhs, const Iterator& rhs) {
+            return lhs.chunkIndex < rhs.chunkIndex || (lhs.chunkIndex == rhs.chunkIndex && lhs.ptr < rhs.ptr);
+        }
+        friend bool operator>(const Iterator& lhs, const Iterator& rhs) {
+            return rhs < lhs;
+        }
+        friend bool operator<=(const Iterator& lhs, const Iterator& rhs) {
+            return !(rhs < lhs);
+        }
+        friend bool operator>=(const Iterator& lhs, const Iterator& rhs) {
+            return !(lhs < rhs);
+        }
+
+    private:
+        template <bool> friend class Iterator;
 
-            return rendPtr;
+        pointer ptr;
+        pointer first;
+        pointer last;
+        size_t chunkIndex;
+        Container* container;
+
+        void setChunk(size_t index) {
+            chunkIndex = index;
+            first = container->chunks[index]->getData();
+            last = first+container->getChunkCapacity();
         }
     };
+
+    namespace pmr {
+        /**
+         * @brief дек, берущий память из std::pmr::memory_resource (например, из ChunkArena)
+         */
+        template <typename T, size_t ChunkCapacity = 0, typename Stats = NoDequeStats>
+        using Deque = Smoren::Containers::Deque<T, ChunkCapacity, std::pmr::polymorphic_allocator<T>, Stats>;
+    }
 }
@@ -5,11 +5,28 @@ CONFIG -= qt
 QMAKE_CXXFLAGS += -std=c++17
 QMAKE_LFLAGS += -pthread
 
+# libstdc++ реализует <execution> поверх TBB, если он установлен
+packagesExist(tbb) {
+    LIBS += -ltbb
+}
+
 SOURCES += main.cpp \
     profiler.cpp
 
 HEADERS += \
+    chunk_arena.h \
     deque.h \
+    deque_algorithm.h \
+    deque_io.h \
+    deque_parallel.h \
+    mapped_deque.h \
     profiler.h \
+    ring_deque.h \
+    sliding_window.h \
+    small_deque.h \
+    spill_deque.h \
+    spsc_queue.h \
+    thread_pool.h \
+    work_stealing_deque.h \
     printer.h
 
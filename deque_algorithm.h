@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include "deque.h"
+
+/**
+ * Алгоритмы, обходящие дек по чанкам.
+ *
+ * Внутри каждого чанка работает простой цикл по указателям без проверок границ,
+ * который компилятор может векторизовать.
+ */
+namespace Smoren::Containers {
+    template <typename T, size_t ChunkCapacity, typename... Options, typename F>
+    F for_each(Deque<T, ChunkCapacity, Options...>& d, F f) {
+        d.for_each_segment([&f](T* first, T* last) {
+            for(; first != last; ++first) {
+                f(*first);
+            }
+        });
+        return f;
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename F>
+    F for_each(const Deque<T, ChunkCapacity, Options...>& d, F f) {
+        d.for_each_segment([&f](const T* first, const T* last) {
+            for(; first != last; ++first) {
+                f(*first);
+            }
+        });
+        return f;
+    }
+
+    /**
+     * @brief сворачивает элементы строго по порядку, как std::accumulate
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Value, typename BinaryOp = std::plus<>>
+    Value accumulate(const Deque<T, ChunkCapacity, Options...>& d, Value init, BinaryOp op = BinaryOp()) {
+        d.for_each_segment([&init, &op](const T* first, const T* last) {
+            for(; first != last; ++first) {
+                init = op(std::move(init), *first);
+            }
+        });
+        return init;
+    }
+
+    namespace AlgorithmDetails {
+        /**
+         * @brief сворачивает непрерывный участок в init
+         *
+         * Участок сворачивается в четыре независимых аккумулятора, поэтому цикл
+         * векторизуется даже для типов с плавающей точкой.
+         */
+        template <typename T, typename Value, typename BinaryOp>
+        Value reduceSegment(const T* first, const T* last, Value init, BinaryOp& op) {
+            const size_t size = last-first;
+            if(size < 8) {
+                for(; first != last; ++first) {
+                    init = op(std::move(init), *first);
+                }
+                return init;
+            }
+
+            Value acc0 = first[0], acc1 = first[1], acc2 = first[2], acc3 = first[3];
+            size_t i = 4;
+            for(; i+4 <= size; i += 4) {
+                acc0 = op(acc0, first[i]);
+                acc1 = op(acc1, first[i+1]);
+                acc2 = op(acc2, first[i+2]);
+                acc3 = op(acc3, first[i+3]);
+            }
+            for(; i < size; i++) {
+                acc0 = op(acc0, first[i]);
+            }
+            return op(std::move(init), op(op(acc0, acc1), op(acc2, acc3)));
+        }
+    }
+
+    /**
+     * @brief сворачивает элементы ассоциативной и коммутативной операцией, как std::reduce
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Value, typename BinaryOp = std::plus<>>
+    Value reduce(const Deque<T, ChunkCapacity, Options...>& d, Value init, BinaryOp op = BinaryOp()) {
+        d.for_each_segment([&init, &op](const T* first, const T* last) {
+            init = AlgorithmDetails::reduceSegment(first, last, std::move(init), op);
+        });
+        return init;
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    size_t count_if(const Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        size_t result = 0;
+        d.for_each_segment([&result, &predicate](const T* first, const T* last) {
+            size_t chunkResult = 0;
+            for(; first != last; ++first) {
+                chunkResult += predicate(*first) ? 1 : 0;
+            }
+            result += chunkResult;
+        });
+        return result;
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    size_t count(const Deque<T, ChunkCapacity, Options...>& d, const T& value) {
+        return count_if(d, [&value](const T& item) { return item == value; });
+    }
+
+    /**
+     * @brief возвращает итератор на первый элемент, удовлетворяющий предикату, или end()
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    typename Deque<T, ChunkCapacity, Options...>::iterator find_if(Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        size_t offset = 0;
+        for(size_t i=0; i<d.chunksCount(); i++) {
+            Segment<T> segment = d.segment(i);
+            T* found = std::find_if(segment.first, segment.last, predicate);
+            if(found != segment.last) {
+                return d.begin()+(offset+(found-segment.first));
+            }
+            offset += segment.size();
+        }
+        return d.end();
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    typename Deque<T, ChunkCapacity, Options...>::const_iterator find_if(const Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        size_t offset = 0;
+        for(size_t i=0; i<d.chunksCount(); i++) {
+            Segment<const T> segment = d.segment(i);
+            const T* found = std::find_if(segment.first, segment.last, predicate);
+            if(found != segment.last) {
+                return d.begin()+(offset+(found-segment.first));
+            }
+            offset += segment.size();
+        }
+        return d.end();
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    typename Deque<T, ChunkCapacity, Options...>::iterator find(Deque<T, ChunkCapacity, Options...>& d, const T& value) {
+        return find_if(d, [&value](const T& item) { return item == value; });
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    typename Deque<T, ChunkCapacity, Options...>::const_iterator find(const Deque<T, ChunkCapacity, Options...>& d, const T& value) {
+        return find_if(d, [&value](const T& item) { return item == value; });
+    }
+
+    /**
+     * @brief копирует элементы дека в output, по одному вызову std::copy на чанк
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename OutputIt>
+    OutputIt copy(const Deque<T, ChunkCapacity, Options...>& d, OutputIt output) {
+        d.for_each_segment([&output](const T* first, const T* last) {
+            output = std::copy(first, last, output);
+        });
+        return output;
+    }
+
+    /**
+     * @brief заменяет каждый элемент результатом op(элемент)
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename UnaryOp>
+    void transform(Deque<T, ChunkCapacity, Options...>& d, UnaryOp op) {
+        d.for_each_segment([&op](T* first, T* last) {
+            for(; first != last; ++first) {
+                *first = op(*first);
+            }
+        });
+    }
+
+    /**
+     * @brief записывает в output результаты op для элементов дека по порядку, как std::transform
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename OutputIt, typename UnaryOp>
+    OutputIt transform(const Deque<T, ChunkCapacity, Options...>& d, OutputIt output, UnaryOp op) {
+        d.for_each_segment([&output, &op](const T* first, const T* last) {
+            output = std::transform(first, last, output, op);
+        });
+        return output;
+    }
+}
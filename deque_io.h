@@ -0,0 +1,527 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "deque.h"
+
+/**
+ * Бинарные снимки деков тривиально копируемых элементов.
+ *
+ * Снимок состоит из заголовка с размером элемента и количеством элементов,
+ * за которым идут байты элементов по порядку. Каждый чанк пишется одним
+ * участком writev, при чтении байты читаются прямо в память новых чанков.
+ */
+namespace Smoren::Containers {
+    namespace SnapshotDetails {
+        constexpr uint64_t magic = 0x4e5351444e524d53; // "SMRNDQSN"
+        constexpr uint64_t logMagic = 0x474c51444e524d53; // "SMRNDQLG"
+        constexpr uint64_t version = 1;
+        constexpr uint64_t logVersion = 2;
+
+        struct Header {
+            uint64_t magic;
+            uint64_t version;
+            uint64_t elementSize;
+            uint64_t size;
+        };
+
+        [[noreturn]] inline void throwSystemError(const char* operation) {
+            throw std::system_error(errno, std::generic_category(), operation);
+        }
+
+        /**
+         * @brief пишет все участки iov, повторяя writev после частичной записи
+         */
+        inline void writeAll(int fd, std::vector<iovec>& iov) {
+            size_t index = 0;
+            while(index < iov.size()) {
+                const int count = static_cast<int>(std::min<size_t>(iov.size()-index, IOV_MAX));
+                const ssize_t written = ::writev(fd, iov.data()+index, count);
+                if(written < 0) {
+                    if(errno == EINTR) {
+                        continue;
+                    }
+                    throwSystemError("writev");
+                }
+
+                size_t rest = static_cast<size_t>(written);
+                while(index < iov.size() && rest >= iov[index].iov_len) {
+                    rest -= iov[index].iov_len;
+                    index++;
+                }
+                if(rest) {
+                    iov[index].iov_base = static_cast<char*>(iov[index].iov_base)+rest;
+                    iov[index].iov_len -= rest;
+                }
+            }
+        }
+
+        /**
+         * @brief читает ровно bytes байт с позиции offset или с текущей позиции, если offset < 0
+         */
+        inline void readAll(int fd, void* destination, size_t bytes, off_t offset = -1) {
+            char* position = static_cast<char*>(destination);
+            while(bytes) {
+                const ssize_t received = offset < 0 ? ::read(fd, position, bytes) : ::pread(fd, position, bytes, offset);
+                if(received < 0) {
+                    if(errno == EINTR) {
+                        continue;
+                    }
+                    throwSystemError("read");
+                }
+                if(received == 0) {
+                    throw std::runtime_error("snapshot is truncated");
+                }
+                position += received;
+                bytes -= static_cast<size_t>(received);
+                if(offset >= 0) {
+                    offset += received;
+                }
+            }
+        }
+
+        template <typename T>
+        void checkHeader(const Header& header) {
+            if(header.magic != magic || header.version != version) {
+                throw std::runtime_error("not a deque snapshot");
+            }
+            if(header.elementSize != sizeof(T)) {
+                throw std::runtime_error("snapshot element size mismatch");
+            }
+        }
+    }
+
+    /**
+     * @brief записывает снимок дека в файловый дескриптор одним вызовом writev на IOV_MAX чанков
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    void save(const Deque<T, ChunkCapacity, Options...>& d, int fd) {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+        SnapshotDetails::Header header = {SnapshotDetails::magic, SnapshotDetails::version, sizeof(T), d.size()};
+        std::vector<iovec> iov;
+        iov.reserve(d.chunksCount()+1);
+        iov.push_back({&header, sizeof(header)});
+        d.for_each_segment([&iov](const T* first, const T* last) {
+            iov.push_back({const_cast<T*>(first), static_cast<size_t>(last-first)*sizeof(T)});
+        });
+        SnapshotDetails::writeAll(fd, iov);
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    void save(const Deque<T, ChunkCapacity, Options...>& d, std::ostream& stream) {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+        const SnapshotDetails::Header header = {SnapshotDetails::magic, SnapshotDetails::version, sizeof(T), d.size()};
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        d.for_each_segment([&stream](const T* first, const T* last) {
+            stream.write(reinterpret_cast<const char*>(first), static_cast<std::streamsize>((last-first)*sizeof(T)));
+        });
+        if(!stream) {
+            throw std::runtime_error("failed to write snapshot");
+        }
+    }
+
+    /**
+     * @brief заменяет содержимое дека снимком, прочитанным из файлового дескриптора
+     *
+     * Чанки выделяются сразу и заполняются чтением прямо в их память.
+     * Размер чанка дека может отличаться от размера чанка в момент сохранения.
+     * При ошибке дек остается пустым.
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    void load(Deque<T, ChunkCapacity, Options...>& d, int fd) {
+        SnapshotDetails::Header header;
+        SnapshotDetails::readAll(fd, &header, sizeof(header));
+        SnapshotDetails::checkHeader<T>(header);
+
+        d.clear();
+        try {
+            d.append_uninitialized(header.size, [fd](T* first, T* last) {
+                SnapshotDetails::readAll(fd, first, static_cast<size_t>(last-first)*sizeof(T));
+            });
+        } catch(...) {
+            d.clear();
+            throw;
+        }
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options>
+    void load(Deque<T, ChunkCapacity, Options...>& d, std::istream& stream) {
+        SnapshotDetails::Header header;
+        if(!stream.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            throw std::runtime_error("snapshot is truncated");
+        }
+        SnapshotDetails::checkHeader<T>(header);
+
+        d.clear();
+        try {
+            d.append_uninitialized(header.size, [&stream](T* first, T* last) {
+                const std::streamsize bytes = static_cast<std::streamsize>((last-first)*sizeof(T));
+                if(stream.read(reinterpret_cast<char*>(first), bytes).gcount() != bytes) {
+                    throw std::runtime_error("snapshot is truncated");
+                }
+            });
+        } catch(...) {
+            d.clear();
+            throw;
+        }
+    }
+
+    /**
+     * @brief журнал снимков дека, в который дописываются только изменившиеся чанки
+     *
+     * Каждая запись журнала содержит заголовок, таблицу чанков (количество элементов и смещение
+     * их байтов в файле), байты новых чанков и завершающую контрольную сумму заголовка,
+     * таблицы и этих байтов. Неизменившиеся чанки ссылаются на байты, записанные раньше.
+     * Изменения через operator[] и итераторы отследить нельзя, поэтому чанк считается прежним,
+     * если совпадают количество элементов и 128-битный хеш его байтов. Хеши прошлой записи
+     * хранятся в памяти, и сохранение неизменившегося дека не читает файл.
+     *
+     * Первая запись в журнал содержит все чанки. Запись, оборванная сбоем, не проходит
+     * проверку контрольной суммы: load восстанавливает предыдущую, а конструктор
+     * обрезает файл после последней целой записи, чтобы новые записи не склеились с оборванной.
+     */
+    template <typename T>
+    class IncrementalSnapshot {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+    public:
+        /**
+         * @brief дописывает записи после последней целой записи fd, отрезая оборванный хвост;
+         * fd должен поддерживать lseek, pread и ftruncate
+         */
+        explicit IncrementalSnapshot(int fd):
+            fd(fd),
+            fileEnd(0)
+        {
+            const std::vector<Record> records = scanRecords(fd, fileBytes(fd));
+            for(size_t i=records.size(); i>0; i--) {
+                std::vector<Entry> table;
+                if(verifyRecord(fd, records[i-1], table)) {
+                    fileEnd = records[i-1].offset+records[i-1].header.recordBytes;
+                    break;
+                }
+            }
+            if(::ftruncate(fd, static_cast<off_t>(fileEnd)) != 0) {
+                SnapshotDetails::throwSystemError("ftruncate");
+            }
+        }
+
+        /**
+         * @brief дописывает запись со снимком дека; возвращает количество записанных чанков
+         */
+        template <size_t ChunkCapacity, typename... Options>
+        size_t save(const Deque<T, ChunkCapacity, Options...>& d) {
+            const size_t chunksCount = d.chunksCount();
+            RecordHeader header = {SnapshotDetails::logMagic, SnapshotDetails::logVersion, sizeof(T), d.size(), chunksCount, 0};
+            std::vector<Entry> table(chunksCount);
+            std::vector<iovec> iov;
+            iov.reserve(chunksCount+3);
+            iov.push_back({&header, sizeof(header)});
+            iov.push_back({table.data(), chunksCount*sizeof(Entry)});
+
+            std::unordered_map<ChunkHash, Entry, ChunkHashHasher> written;
+            written.reserve(chunksCount);
+            std::vector<ChunkHash> writtenHashes;
+            uint64_t dataOffset = fileEnd+sizeof(header)+chunksCount*sizeof(Entry);
+
+            for(size_t i=0; i<chunksCount; i++) {
+                const Segment<const T> segment = d.segment(i);
+                const uint64_t bytes = segment.size()*sizeof(T);
+                const ChunkHash hash = hashBytes(segment.first, bytes);
+
+                const auto previous = lastChunks.find(hash);
+                if(previous != lastChunks.end() && previous->second.count == segment.size()) {
+                    table[i] = previous->second;
+                } else {
+                    table[i] = {segment.size(), dataOffset};
+                    iov.push_back({const_cast<T*>(segment.first), bytes});
+                    writtenHashes.push_back(hash);
+                    dataOffset += bytes;
+                }
+                written[hash] = table[i];
+            }
+            header.recordBytes = dataOffset+sizeof(RecordTrailer)-fileEnd;
+
+            uint64_t checksum = addToChecksum(checksumSeed, hashBytes(&header, sizeof(header)));
+            checksum = addToChecksum(checksum, hashBytes(table.data(), table.size()*sizeof(Entry)));
+            for(const ChunkHash& hash : writtenHashes) {
+                checksum = addToChecksum(checksum, hash);
+            }
+            RecordTrailer trailer = {checksum, SnapshotDetails::logMagic};
+            iov.push_back({&trailer, sizeof(trailer)});
+
+            if(::lseek(fd, static_cast<off_t>(fileEnd), SEEK_SET) < 0) {
+                SnapshotDetails::throwSystemError("lseek");
+            }
+            try {
+                SnapshotDetails::writeAll(fd, iov);
+            } catch(...) {
+                // не оставляем оборванную запись перед следующей
+                [[maybe_unused]] const int result = ::ftruncate(fd, static_cast<off_t>(fileEnd));
+                throw;
+            }
+
+            fileEnd = dataOffset+sizeof(RecordTrailer);
+            lastChunks.swap(written);
+            return writtenHashes.size();
+        }
+
+        /**
+         * @brief заменяет содержимое дека последней записью журнала из fd, прошедшей проверку контрольной суммы
+         */
+        template <size_t ChunkCapacity, typename... Options>
+        static void load(Deque<T, ChunkCapacity, Options...>& d, int fd) {
+            const std::vector<Record> records = scanRecords(fd, fileBytes(fd));
+            std::vector<Entry> table;
+            const Record* lastRecord = nullptr;
+            for(size_t i=records.size(); i>0; i--) {
+                if(verifyRecord(fd, records[i-1], table)) {
+                    lastRecord = &records[i-1];
+                    break;
+                }
+            }
+            if(lastRecord == nullptr) {
+                throw std::runtime_error("snapshot log has no complete records");
+            }
+
+            // чанки дека и записанные чанки могут не совпадать по границам
+            size_t entry = 0;
+            uint64_t entryDone = 0;
+            d.clear();
+            try {
+                d.append_uninitialized(lastRecord->header.size, [&](T* first, T* last) {
+                    while(first != last) {
+                        while(entryDone == table[entry].count) {
+                            entry++;
+                            entryDone = 0;
+                        }
+                        const size_t portion = std::min<uint64_t>(last-first, table[entry].count-entryDone);
+                        const uint64_t offset = table[entry].offset+entryDone*sizeof(T);
+                        SnapshotDetails::readAll(fd, first, portion*sizeof(T), static_cast<off_t>(offset));
+                        first += portion;
+                        entryDone += portion;
+                    }
+                });
+            } catch(...) {
+                d.clear();
+                throw;
+            }
+        }
+
+    protected:
+        struct RecordHeader {
+            uint64_t magic;
+            uint64_t version;
+            uint64_t elementSize;
+            uint64_t size;
+            uint64_t chunksCount;
+            uint64_t recordBytes; // вместе с заголовком и RecordTrailer
+        };
+
+        struct Entry {
+            uint64_t count;
+            uint64_t offset;
+        };
+
+        struct RecordTrailer {
+            uint64_t checksum;
+            uint64_t magic;
+        };
+
+        struct Record {
+            uint64_t offset;
+            RecordHeader header;
+        };
+
+        /**
+         * @brief 128-битный хеш байтов чанка
+         */
+        struct ChunkHash {
+            uint64_t low;
+            uint64_t high;
+
+            bool operator ==(const ChunkHash& other) const {
+                return low == other.low && high == other.high;
+            }
+        };
+
+        struct ChunkHashHasher {
+            size_t operator ()(const ChunkHash& hash) const {
+                return static_cast<size_t>(hash.low);
+            }
+        };
+
+        static constexpr uint64_t checksumSeed = 0x6a09e667f3bcc909;
+
+        int fd;
+        uint64_t fileEnd;
+        // чанки последней записи по хешу их байтов
+        std::unordered_map<ChunkHash, Entry, ChunkHashHasher> lastChunks;
+
+        static uint64_t fileBytes(int fd) {
+            struct stat info;
+            if(fstat(fd, &info) != 0) {
+                SnapshotDetails::throwSystemError("fstat");
+            }
+            return static_cast<uint64_t>(info.st_size);
+        }
+
+        /**
+         * @brief собирает подряд идущие записи с правдоподобными заголовками; контрольные суммы не проверяет
+         *
+         * Если файл не пуст и не начинается с записи журнала, бросает std::runtime_error,
+         * чтобы конструктор не обрезал чужой файл.
+         */
+        static std::vector<Record> scanRecords(int fd, uint64_t fileBytes) {
+            std::vector<Record> records;
+            if(fileBytes == 0) {
+                return records;
+            }
+            uint64_t magic = 0;
+            if(fileBytes < sizeof(magic)) {
+                throw std::runtime_error("not a snapshot log");
+            }
+            SnapshotDetails::readAll(fd, &magic, sizeof(magic), 0);
+            if(magic != SnapshotDetails::logMagic) {
+                throw std::runtime_error("not a snapshot log");
+            }
+
+            for(uint64_t offset=0; offset+sizeof(RecordHeader) <= fileBytes;) {
+                RecordHeader header;
+                SnapshotDetails::readAll(fd, &header, sizeof(header), static_cast<off_t>(offset));
+                if(header.magic != SnapshotDetails::logMagic) {
+                    break;
+                }
+                if(offset == 0 && header.version != SnapshotDetails::logVersion) {
+                    throw std::runtime_error("snapshot log version mismatch");
+                }
+                if(offset == 0 && header.elementSize != sizeof(T)) {
+                    throw std::runtime_error("snapshot element size mismatch");
+                }
+                const uint64_t minBytes = sizeof(RecordHeader)+sizeof(RecordTrailer);
+                if(header.version != SnapshotDetails::logVersion || header.elementSize != sizeof(T)
+                    || header.recordBytes < minBytes || header.recordBytes > fileBytes-offset
+                    || header.chunksCount > (header.recordBytes-minBytes)/sizeof(Entry)) {
+                    break;
+                }
+                records.push_back({offset, header});
+                offset += header.recordBytes;
+            }
+            return records;
+        }
+
+        /**
+         * @brief читает таблицу записи в table и проверяет ее и контрольную сумму
+         *
+         * Новые чанки должны лежать подряд в данных самой записи, прежние — целиком до ее начала.
+         */
+        static bool verifyRecord(int fd, const Record& record, std::vector<Entry>& table) {
+            const RecordHeader& header = record.header;
+            const uint64_t tableOffset = record.offset+sizeof(RecordHeader);
+            const uint64_t dataEnd = record.offset+header.recordBytes-sizeof(RecordTrailer);
+            table.resize(header.chunksCount);
+            SnapshotDetails::readAll(fd, table.data(), table.size()*sizeof(Entry), static_cast<off_t>(tableOffset));
+
+            uint64_t checksum = addToChecksum(checksumSeed, hashBytes(&header, sizeof(header)));
+            checksum = addToChecksum(checksum, hashBytes(table.data(), table.size()*sizeof(Entry)));
+
+            std::vector<unsigned char> buffer;
+            uint64_t nextData = tableOffset+table.size()*sizeof(Entry);
+            uint64_t elements = 0;
+            for(const Entry& entry : table) {
+                if(entry.count > header.size-elements) {
+                    return false;
+                }
+                elements += entry.count;
+                const uint64_t bytes = entry.count*sizeof(T);
+                if(entry.offset >= record.offset) {
+                    if(entry.offset != nextData || bytes > dataEnd-nextData) {
+                        return false;
+                    }
+                    buffer.resize(bytes);
+                    SnapshotDetails::readAll(fd, buffer.data(), bytes, static_cast<off_t>(entry.offset));
+                    checksum = addToChecksum(checksum, hashBytes(buffer.data(), bytes));
+                    nextData += bytes;
+                } else if(bytes > record.offset-entry.offset) {
+                    return false;
+                }
+            }
+            if(elements != header.size || nextData != dataEnd) {
+                return false;
+            }
+
+            RecordTrailer trailer;
+            SnapshotDetails::readAll(fd, &trailer, sizeof(trailer), static_cast<off_t>(dataEnd));
+            return trailer.magic == SnapshotDetails::logMagic && trailer.checksum == checksum;
+        }
+
+        static uint64_t addToChecksum(uint64_t checksum, const ChunkHash& hash) {
+            checksum = (checksum ^ hash.low)*0x9e3779b97f4a7c15;
+            checksum = (checksum ^ (checksum >> 31) ^ hash.high)*0xbf58476d1ce4e5b9;
+            return checksum ^ (checksum >> 29);
+        }
+
+        /**
+         * @brief 128-битный хеш: четыре независимые цепочки по 8 байт, чтобы умножения шли параллельно
+         */
+        static ChunkHash hashBytes(const void* data, size_t bytes) {
+            constexpr uint64_t k1 = 0x87c37b91114253d5;
+            constexpr uint64_t k2 = 0x4cf5ad432745937f;
+            const unsigned char* position = static_cast<const unsigned char*>(data);
+            uint64_t lanes[4] = {0x9e3779b97f4a7c15 ^ bytes, 0xc2b2ae3d27d4eb4f, 0x165667b19e3779f9, 0x27d4eb2f165667c5 ^ bytes};
+
+            auto mixWord = [](uint64_t lane, uint64_t word) {
+                lane ^= word*k1;
+                return rotateLeft(lane, 31)*k2;
+            };
+
+            for(; bytes >= 4*sizeof(uint64_t); bytes -= 4*sizeof(uint64_t), position += 4*sizeof(uint64_t)) {
+                uint64_t words[4];
+                std::memcpy(words, position, sizeof(words));
+                for(size_t i=0; i<4; i++) {
+                    lanes[i] = mixWord(lanes[i], words[i]);
+                }
+            }
+            for(size_t i=0; bytes; i++) {
+                uint64_t word = 0;
+                const size_t portion = std::min(bytes, sizeof(word));
+                std::memcpy(&word, position, portion);
+                lanes[i] = mixWord(lanes[i], word ^ (portion << 56));
+                bytes -= portion;
+                position += portion;
+            }
+
+            const uint64_t low = finalize(lanes[0]+rotateLeft(lanes[1], 17)+rotateLeft(lanes[2], 37)+rotateLeft(lanes[3], 53));
+            const uint64_t high = finalize(lanes[1]^rotateLeft(lanes[2], 23)^rotateLeft(lanes[3], 41)^rotateLeft(lanes[0], 59)^k1);
+            return {low, high};
+        }
+
+        static uint64_t rotateLeft(uint64_t value, int shift) {
+            return (value << shift) | (value >> (64-shift));
+        }
+
+        static uint64_t finalize(uint64_t value) {
+            value ^= value >> 33;
+            value *= 0xff51afd7ed558ccd;
+            value ^= value >> 33;
+            value *= 0xc4ceb9fe1a85ec53;
+            return value ^ (value >> 33);
+        }
+    };
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#if __has_include(<execution>)
+#include <execution>
+#endif
+#include "deque.h"
+#include "deque_algorithm.h"
+#include "thread_pool.h"
+
+/**
+ * Параллельные алгоритмы, делящие дек на части по границам чанков.
+ *
+ * Часть — это несколько соседних целых чанков. Размер части считается в элементах,
+ * поэтому частично заполненные крайние чанки весят меньше полных, а чанк больше
+ * размера части делится на равные куски. Частей в несколько раз больше, чем потоков пула:
+ * освободившийся поток берет следующую часть, и отставшие потоки не задерживают остальные.
+ *
+ * Алгоритмы принимают пул явно или стандартную политику исполнения:
+ * std::execution::seq выполняет последовательную версию из deque_algorithm.h,
+ * par и par_unseq — параллельную на ThreadPool::shared().
+ * Переданные функции вызываются из нескольких потоков одновременно.
+ */
+namespace Smoren::Containers {
+    namespace ParallelDetails {
+        // меньшие части не окупают раздачу задач
+        constexpr size_t minPartSize = 4096;
+        constexpr size_t partsPerThread = 4;
+
+        struct Part {
+            size_t chunk;   // номер первого чанка части
+            size_t offset;  // смещение первого элемента части внутри этого чанка
+            size_t index;   // номер первого элемента части в деке
+            size_t size;
+        };
+
+        template <typename DequeType>
+        std::vector<Part> partition(const DequeType& d, size_t threadsCount) {
+            std::vector<Part> parts;
+            const size_t partsCount = threadsCount*partsPerThread;
+            const size_t partSize = std::max(minPartSize, (d.size()+partsCount-1)/partsCount);
+
+            Part current{0, 0, 0, 0};
+            size_t index = 0;
+            for(size_t i=0; i<d.chunksCount(); i++) {
+                const size_t size = d.segment(i).size();
+                if(current.size && current.size+size > partSize) {
+                    parts.push_back(current);
+                    current.size = 0;
+                }
+                if(size > partSize) {
+                    const size_t pieces = (size+partSize-1)/partSize;
+                    for(size_t k=0; k<pieces; k++) {
+                        const size_t first = size*k/pieces;
+                        parts.push_back({i, first, index+first, size*(k+1)/pieces-first});
+                    }
+                } else if(size) {
+                    if(!current.size) {
+                        current = {i, 0, index, 0};
+                    }
+                    current.size += size;
+                }
+                index += size;
+            }
+            if(current.size) {
+                parts.push_back(current);
+            }
+            return parts;
+        }
+
+        /**
+         * @brief вызывает f(first, last) для непрерывных участков части по порядку
+         */
+        template <typename DequeType, typename F>
+        void forEachSegment(DequeType& d, const Part& part, F& f) {
+            size_t chunk = part.chunk;
+            size_t offset = part.offset;
+            size_t rest = part.size;
+            while(rest) {
+                auto segment = d.segment(chunk++);
+                const size_t size = std::min(segment.size()-offset, rest);
+                if(size) {
+                    f(segment.first+offset, segment.first+offset+size);
+                }
+                rest -= size;
+                offset = 0;
+            }
+        }
+
+        template <typename DequeType, typename F>
+        void forEachElement(Smoren::Tools::ThreadPool& pool, DequeType& d, F& f) {
+            const std::vector<Part> parts = partition(d, pool.size());
+            pool.parallel_for(parts.size(), [&d, &f, &parts](size_t i) {
+                auto apply = [&f](auto first, auto last) {
+                    for(; first != last; ++first) {
+                        f(*first);
+                    }
+                };
+                forEachSegment(d, parts[i], apply);
+            });
+        }
+
+        /**
+         * @brief возвращает номер первого элемента, удовлетворяющего предикату, или d.size()
+         *
+         * Найденный номер хранится в атомарном минимуме: части после него не просматриваются,
+         * а часть прекращает поиск после первого совпадения.
+         */
+        template <typename DequeType, typename Predicate>
+        size_t findIndex(Smoren::Tools::ThreadPool& pool, DequeType& d, Predicate& predicate) {
+            const std::vector<Part> parts = partition(d, pool.size());
+            std::atomic<size_t> found(d.size());
+            pool.parallel_for(parts.size(), [&d, &predicate, &parts, &found](size_t i) {
+                size_t index = parts[i].index;
+                bool done = false;
+                auto search = [&](auto first, auto last) {
+                    if(done || index >= found.load(std::memory_order_relaxed)) {
+                        done = true;
+                        return;
+                    }
+                    auto position = std::find_if(first, last, predicate);
+                    if(position != last) {
+                        const size_t candidate = index+(position-first);
+                        size_t current = found.load(std::memory_order_relaxed);
+                        while(candidate < current && !found.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+                        done = true;
+                    }
+                    index += last-first;
+                };
+                forEachSegment(d, parts[i], search);
+            });
+            return found.load(std::memory_order_relaxed);
+        }
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename F>
+    void for_each(Smoren::Tools::ThreadPool& pool, Deque<T, ChunkCapacity, Options...>& d, F f) {
+        ParallelDetails::forEachElement(pool, d, f);
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename F>
+    void for_each(Smoren::Tools::ThreadPool& pool, const Deque<T, ChunkCapacity, Options...>& d, F f) {
+        ParallelDetails::forEachElement(pool, d, f);
+    }
+
+    /**
+     * @brief заменяет каждый элемент результатом op(элемент)
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename UnaryOp>
+    void transform(Smoren::Tools::ThreadPool& pool, Deque<T, ChunkCapacity, Options...>& d, UnaryOp op) {
+        auto assign = [&op](T& item) { item = op(item); };
+        ParallelDetails::forEachElement(pool, d, assign);
+    }
+
+    /**
+     * @brief записывает в output результаты op для элементов дека по порядку
+     *
+     * Каждая часть пишет с позиции output+(номер ее первого элемента), поэтому output
+     * должен быть итератором произвольного доступа на d.size() элементов.
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename OutputIt, typename UnaryOp>
+    OutputIt transform(Smoren::Tools::ThreadPool& pool, const Deque<T, ChunkCapacity, Options...>& d, OutputIt output, UnaryOp op) {
+        static_assert(
+            std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<OutputIt>::iterator_category>,
+            "OutputIt must be a random access iterator"
+        );
+        using Difference = typename std::iterator_traits<OutputIt>::difference_type;
+
+        const std::vector<ParallelDetails::Part> parts = ParallelDetails::partition(d, pool.size());
+        pool.parallel_for(parts.size(), [&d, &op, &parts, output](size_t i) {
+            OutputIt position = output+static_cast<Difference>(parts[i].index);
+            auto apply = [&position, &op](const T* first, const T* last) {
+                position = std::transform(first, last, position, op);
+            };
+            ParallelDetails::forEachSegment(d, parts[i], apply);
+        });
+        return output+static_cast<Difference>(d.size());
+    }
+
+    /**
+     * @brief сворачивает элементы ассоциативной и коммутативной операцией, как std::reduce
+     *
+     * Части сворачиваются параллельно, их результаты добавляются к init по порядку частей.
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Value, typename BinaryOp = std::plus<>>
+    Value reduce(Smoren::Tools::ThreadPool& pool, const Deque<T, ChunkCapacity, Options...>& d, Value init, BinaryOp op = BinaryOp()) {
+        const std::vector<ParallelDetails::Part> parts = ParallelDetails::partition(d, pool.size());
+        std::vector<std::optional<Value>> partials(parts.size());
+        pool.parallel_for(parts.size(), [&d, &op, &parts, &partials](size_t i) {
+            std::optional<Value> partial;
+            auto apply = [&partial, &op](const T* first, const T* last) {
+                if(!partial) {
+                    partial.emplace(*first++);
+                }
+                partial = AlgorithmDetails::reduceSegment(first, last, std::move(*partial), op);
+            };
+            ParallelDetails::forEachSegment(d, parts[i], apply);
+            partials[i] = std::move(partial);
+        });
+
+        for(std::optional<Value>& partial : partials) {
+            init = op(std::move(init), std::move(*partial));
+        }
+        return init;
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    size_t count_if(Smoren::Tools::ThreadPool& pool, const Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        const std::vector<ParallelDetails::Part> parts = ParallelDetails::partition(d, pool.size());
+        std::vector<size_t> counts(parts.size());
+        pool.parallel_for(parts.size(), [&d, &predicate, &parts, &counts](size_t i) {
+            size_t result = 0;
+            auto apply = [&result, &predicate](const T* first, const T* last) {
+                for(; first != last; ++first) {
+                    result += predicate(*first) ? 1 : 0;
+                }
+            };
+            ParallelDetails::forEachSegment(d, parts[i], apply);
+            counts[i] = result;
+        });
+
+        size_t result = 0;
+        for(size_t count : counts) {
+            result += count;
+        }
+        return result;
+    }
+
+    /**
+     * @brief возвращает итератор на первый элемент, удовлетворяющий предикату, или end()
+     */
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    typename Deque<T, ChunkCapacity, Options...>::iterator find_if(Smoren::Tools::ThreadPool& pool, Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        return d.begin()+ParallelDetails::findIndex(pool, d, predicate);
+    }
+
+    template <typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    typename Deque<T, ChunkCapacity, Options...>::const_iterator find_if(Smoren::Tools::ThreadPool& pool, const Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        return d.begin()+ParallelDetails::findIndex(pool, d, predicate);
+    }
+
+#ifdef __cpp_lib_execution
+    namespace ParallelDetails {
+        template <typename ExecutionPolicy, typename Result>
+        using EnableIfPolicy = std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, Result>;
+
+        template <typename ExecutionPolicy>
+        constexpr bool isSequenced = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename F>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, void> for_each(ExecutionPolicy&&, Deque<T, ChunkCapacity, Options...>& d, F f) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            for_each(d, std::move(f));
+        } else {
+            for_each(Smoren::Tools::ThreadPool::shared(), d, std::move(f));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename F>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, void> for_each(ExecutionPolicy&&, const Deque<T, ChunkCapacity, Options...>& d, F f) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            for_each(d, std::move(f));
+        } else {
+            for_each(Smoren::Tools::ThreadPool::shared(), d, std::move(f));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename UnaryOp>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, void> transform(ExecutionPolicy&&, Deque<T, ChunkCapacity, Options...>& d, UnaryOp op) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            transform(d, std::move(op));
+        } else {
+            transform(Smoren::Tools::ThreadPool::shared(), d, std::move(op));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename OutputIt, typename UnaryOp>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, OutputIt> transform(ExecutionPolicy&&, const Deque<T, ChunkCapacity, Options...>& d, OutputIt output, UnaryOp op) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            return transform(d, output, std::move(op));
+        } else {
+            return transform(Smoren::Tools::ThreadPool::shared(), d, output, std::move(op));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename Value, typename BinaryOp = std::plus<>>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, Value> reduce(ExecutionPolicy&&, const Deque<T, ChunkCapacity, Options...>& d, Value init, BinaryOp op = BinaryOp()) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            return reduce(d, std::move(init), std::move(op));
+        } else {
+            return reduce(Smoren::Tools::ThreadPool::shared(), d, std::move(init), std::move(op));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, size_t> count_if(ExecutionPolicy&&, const Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            return count_if(d, std::move(predicate));
+        } else {
+            return count_if(Smoren::Tools::ThreadPool::shared(), d, std::move(predicate));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, typename Deque<T, ChunkCapacity, Options...>::iterator>
+    find_if(ExecutionPolicy&&, Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            return find_if(d, std::move(predicate));
+        } else {
+            return find_if(Smoren::Tools::ThreadPool::shared(), d, std::move(predicate));
+        }
+    }
+
+    template <typename ExecutionPolicy, typename T, size_t ChunkCapacity, typename... Options, typename Predicate>
+    ParallelDetails::EnableIfPolicy<ExecutionPolicy, typename Deque<T, ChunkCapacity, Options...>::const_iterator>
+    find_if(ExecutionPolicy&&, const Deque<T, ChunkCapacity, Options...>& d, Predicate predicate) {
+        if constexpr(ParallelDetails::isSequenced<ExecutionPolicy>) {
+            return find_if(d, std::move(predicate));
+        } else {
+            return find_if(Smoren::Tools::ThreadPool::shared(), d, std::move(predicate));
+        }
+    }
+#endif
+}
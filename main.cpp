@@ -1,7 +1,32 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
 #include "printer.h"
 #include "profiler.h"
+#include "chunk_arena.h"
 #include "deque.h"
+#include "deque_algorithm.h"
+#include "deque_io.h"
+#include "deque_parallel.h"
+#include "mapped_deque.h"
+#include "ring_deque.h"
+#include "sliding_window.h"
+#include "small_deque.h"
+#include "spill_deque.h"
+#include "spsc_queue.h"
+#include "work_stealing_deque.h"
 
 
 using namespace std;
@@ -10,19 +35,58 @@ using namespace Smoren::Tools;
 
 void printDequeVerbose(const Deque<int>& d);
 void testMyDeque();
+void testMyDequeBulkPop();
 void testMyDequeBench();
+void testChunkCapacityBench();
+void testChunkBytesBench();
+void testSpareChunksBench();
+void testSegmentsBench();
+void testBulkAppendBench();
+void testSpscQueueBench();
+void testWorkStealingBench();
+void testChunkArenaBench();
+void testMappedDequeBench();
+void testSpillDequeBench();
+void testSnapshotBench();
+void testInsertEraseBench();
+void testRingDequeBench();
+void testSlidingWindowBench();
+void testDequeStatsBench();
+void testReserveBench();
+void testCopyMoveBench();
+void testSmallDequeBench();
+void testParallelAlgorithmsBench();
 
 int main() {
     testMyDeque();
+    testMyDequeBulkPop();
     testMyDequeBench();
+    testChunkCapacityBench();
+    testChunkBytesBench();
+    testSpareChunksBench();
+    testSegmentsBench();
+    testBulkAppendBench();
+    testSpscQueueBench();
+    testWorkStealingBench();
+    testChunkArenaBench();
+    testMappedDequeBench();
+    testSpillDequeBench();
+    testSnapshotBench();
+    testInsertEraseBench();
+    testRingDequeBench();
+    testSlidingWindowBench();
+    testDequeStatsBench();
+    testReserveBench();
+    testCopyMoveBench();
+    testSmallDequeBench();
+    testParallelAlgorithmsBench();
 
     return 0;
 }
 
 void printDequeVerbose(const Deque<int>& d) {
     cout << d << endl;
-    cout << "SIZE: " << d.size() << endl;
-    d.printData();
+    cout << d.report() << endl;
     cout << "==========" << endl << endl;
 }
 
@@ -82,7 +146,7 @@ void testMyDeque() {
         }
         cout << endl;
 
-        for(auto it = d.rbegin(); it != d.rend(); it--) {
+        for(auto it = d.rbegin(); it != d.rend(); it++) {
             cout << *it << ", ";
         }
         cout << endl;
@@ -92,8 +156,165 @@ void testMyDeque() {
         }
         cout << endl;
     }
+    {
+        Deque<int> d(4);
+        for(int i=0; i<10; i++) {
+            d.push_back((i*7)%10);
+            d.push_front((i*3)%10);
+        }
+        cout << d << endl;
+
+        sort(d.begin(), d.end());
+        cout << d << endl;
+
+        auto it = lower_bound(d.begin(), d.end(), 5);
+        cout << "lower_bound(5): index " << (it-d.begin()) << ", value " << *it << endl;
+        cout << endl;
+    }
+}
+
+/**
+ * @brief элемент, который считает живые экземпляры и помечает перемещенный источник значением -1
+ */
+struct TrackedItem {
+    static int alive;
+    int value;
+
+    TrackedItem(int value): value(value) { alive++; }
+    TrackedItem(const TrackedItem& item): value(item.value) { alive++; }
+    TrackedItem(TrackedItem&& item) noexcept: value(item.value) { item.value = -1; alive++; }
+    TrackedItem& operator =(const TrackedItem& item) = default;
+    TrackedItem& operator =(TrackedItem&& item) noexcept {
+        value = item.value;
+        item.value = -1;
+        return *this;
+    }
+    ~TrackedItem() { alive--; }
+
+    friend ostream& operator <<(ostream& stream, const TrackedItem& item) {
+        return stream << item.value;
+    }
+};
+
+int TrackedItem::alive = 0;
+
+void testMyDequeBulkPop() {
+    {
+        Deque<int> d(4);
+        for(int i=0; i<14; i++) {
+            d.push_back(i);
+        }
+        printDequeVerbose(d);
+
+        // через границы чанков
+        d.pop_front_n(6);
+        printDequeVerbose(d);
+
+        d.pop_back_n(5);
+        printDequeVerbose(d);
+
+        d.pop_front_n(0);
+        d.pop_back_n(0);
+        printDequeVerbose(d);
+
+        d.pop_front_n(d.size());
+        printDequeVerbose(d);
+
+        for(int i=0; i<6; i++) {
+            d.push_front(i);
+        }
+        d.pop_back_n(d.size());
+        printDequeVerbose(d);
+    }
+    {
+        Deque<int> d(4);
+        for(int i=0; i<10; i++) {
+            d.push_back(i);
+        }
+
+        vector<int> output;
+        d.drain_front(7, back_inserter(output));
+        cout << "drain_front(7, iterator): " << Smoren::Tools::join(output, ", ") << "; left " << d << endl;
+
+        int buffer[8] = {};
+        size_t drained = d.drain_front(buffer, 8);
+        cout << "drain_front(buffer, 8) on " << drained << " elements: ";
+        for(size_t i=0; i<drained; i++) {
+            cout << buffer[i] << ", ";
+        }
+        cout << "left " << d << endl;
+
+        cout << "drain_front(buffer, 8) on empty: " << d.drain_front(buffer, 8) << endl;
+        cout << "drain_front(buffer, 0) on empty: " << d.drain_front(buffer, 0) << endl;
+
+#if __cplusplus > 201703L
+        for(int i=0; i<6; i++) {
+            d.push_back(i*10);
+        }
+        drained = d.drain_front(std::span<int>(buffer, 4));
+        cout << "drain_front(span of 4): " << drained << " elements, left " << d << endl;
+#endif
+        cout << endl;
+    }
+    {
+        vector<TrackedItem> output;
+        output.reserve(16);
+        {
+            Deque<TrackedItem> d(4);
+            for(int i=0; i<10; i++) {
+                d.push_back(TrackedItem(i));
+            }
+            cout << "TrackedItem alive after fill: " << TrackedItem::alive << endl;
+
+            d.drain_front(3, back_inserter(output));
+            // перемещенные исходные элементы должны быть разрушены: живы только элементы дека и output
+            cout << "drain_front(3): " << Smoren::Tools::join(output, ", ") << "; left " << d << endl;
+            cout << "TrackedItem alive after drain: " << TrackedItem::alive << ", expected " << d.size()+output.size() << endl;
+
+            TrackedItem buffer[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            size_t drained = d.drain_front(buffer, 8);
+            cout << "drain_front(buffer, 8): " << drained << " elements, first " << buffer[0] << ", last " << buffer[drained-1] << endl;
+            cout << "TrackedItem alive after drain to buffer: " << TrackedItem::alive << ", expected " << d.size()+output.size()+8 << endl;
+
+            for(int i=0; i<9; i++) {
+                d.push_back(TrackedItem(100+i));
+            }
+            d.pop_front_n(5);
+            d.pop_back_n(2);
+            cout << "After pop_front_n(5), pop_back_n(2): " << d << ", alive " << TrackedItem::alive << endl;
+        }
+        cout << "TrackedItem alive after deque destroyed: " << TrackedItem::alive << endl;
+        output.clear();
+        cout << "TrackedItem alive after output cleared: " << TrackedItem::alive << endl;
+        cout << endl;
+    }
+    {
+        Deque<int> d(4);
+        for(int i=0; i<20; i++) {
+            d.push_back(i);
+        }
+        d.clear(true);
+        cout << "clear(true): size " << d.size() << ", spare chunks " << d.spareChunksCount() << endl;
+
+        for(int i=0; i<10; i++) {
+            d.push_front(-i);
+        }
+        cout << "Reuse after clear(true): " << d << ", spare chunks " << d.spareChunksCount() << endl;
+
+        d.trimSpareChunks(1);
+        cout << "trimSpareChunks(1): spare chunks " << d.spareChunksCount() << endl;
+        d.trimSpareChunks();
+        cout << "trimSpareChunks(): spare chunks " << d.spareChunksCount() << endl;
+
+        d.clear();
+        cout << "clear(): size " << d.size() << ", spare chunks " << d.spareChunksCount() << endl;
+        cout << endl;
+    }
 }
 
+/**
+ * Быстрая проверка на глаз; полноценные замеры с медианой и p99 собирает benchmark.pro.
+ */
 void testMyDequeBench() {
     size_t SIZE = 1000000;
     {
@@ -105,12 +326,14 @@ void testMyDequeBench() {
         for(size_t i=0; i<SIZE; i++) {
             d.push_front(-1);
         }
+        long long sum = 0;
         for(size_t i=0; i<SIZE*2; i++) {
-            int& a = d[i];
+            sum += d[i];
         }
-        for(auto& x : d) {
-
+        for(int x : d) {
+            sum += x;
         }
+        cout << "Deque sum: " << sum << endl;
         cout << "Deque size: " << d.size() << endl;
         cout << "Deque chunks: " << d.chunksCount() << endl;
         for(size_t i=0; i<SIZE; i++) {
@@ -122,7 +345,7 @@ void testMyDequeBench() {
     }
     cout << endl;
     {
-        LOG_DURATION("Deque");
+        LOG_DURATION("std::deque");
         deque<int> d;
         for(size_t i=0; i<SIZE; i++) {
             d.push_back(1);
@@ -130,18 +353,860 @@ void testMyDequeBench() {
         for(size_t i=0; i<SIZE; i++) {
             d.push_front(-1);
         }
+        long long sum = 0;
         for(size_t i=0; i<SIZE*2; i++) {
-            int& a = d[i];
+            sum += d[i];
         }
-        for(auto& x : d) {
-
+        for(int x : d) {
+            sum += x;
         }
-        cout << "Deque size: " << d.size() << endl;
+        cout << "std::deque sum: " << sum << endl;
+        cout << "std::deque size: " << d.size() << endl;
         for(size_t i=0; i<SIZE; i++) {
             d.pop_back();
             d.pop_front();
         }
-        cout << "Deque size after pop: " << d.size() << endl;
+        cout << "std::deque size after pop: " << d.size() << endl;
+    }
+    cout << endl;
+}
+
+template <typename DequeType>
+void benchRandomAccess(const string& name, DequeType& d, const vector<size_t>& indexes) {
+    for(size_t i=0; i<indexes.size(); i++) {
+        d.push_back(static_cast<int>(i));
+    }
+    long long sum = 0;
+    {
+        LOG_DURATION(name);
+        for(size_t k=0; k<10; k++) {
+            for(size_t i : indexes) {
+                sum += d[i];
+            }
+        }
+    }
+    cout << name << " checksum: " << sum << endl;
+}
+
+void testChunkCapacityBench() {
+    size_t SIZE = 1000000;
+    mt19937 generator(42);
+    uniform_int_distribution<size_t> distribution(0, SIZE-1);
+    vector<size_t> indexes(SIZE);
+    for(auto& index : indexes) {
+        index = distribution(generator);
+    }
+    {
+        Deque<int> d(128);
+        benchRandomAccess("Deque<int>(128) random access", d, indexes);
+    }
+    {
+        Deque<int, 128> d;
+        benchRandomAccess("Deque<int, 128> random access", d, indexes);
+    }
+    {
+        deque<int> d;
+        benchRandomAccess("std::deque<int> random access", d, indexes);
+    }
+    cout << endl;
+}
+
+void benchChunkSizing(const string& name, Deque<int>& d, size_t size) {
+    {
+        LOG_DURATION(name + " push_back");
+        for(size_t i=0; i<size; i++) {
+            d.push_back(static_cast<int>(i));
+        }
+    }
+    cout << name << " chunk capacity: " << d.getChunkCapacity() << ", chunks: " << d.chunksCount() << endl;
+}
+
+void testChunkBytesBench() {
+    const size_t SIZE = 10000000;
+    {
+        Deque<int> d(100);
+        benchChunkSizing("Deque<int>(100)", d, SIZE);
+    }
+    {
+        Deque<int> d(ChunkBytes{4096});
+        benchChunkSizing("Deque<int>(ChunkBytes{4096})", d, SIZE);
+    }
+    {
+        Deque<int> d(ChunkBytes{256, 1 << 16});
+        benchChunkSizing("Deque<int>(ChunkBytes{256, 64K})", d, SIZE);
+    }
+    {
+        Deque<int> small(ChunkBytes{256, 1 << 16});
+        for(int i=0; i<10; i++) {
+            small.push_back(i);
+        }
+        cout << "Small adaptive deque chunk bytes: " << small.getChunkCapacity()*sizeof(int) << endl;
+    }
+    cout << endl;
+}
+
+template <typename D>
+void benchFifo(const string& name, D& d, size_t size, size_t iterations) {
+    for(size_t i=0; i<size; i++) {
+        d.push_back(static_cast<int>(i));
+    }
+    long long sum = 0;
+    {
+        LOG_DURATION(name);
+        for(size_t i=0; i<iterations; i++) {
+            d.push_back(static_cast<int>(i));
+            sum += d[0];
+            d.pop_front();
+        }
+    }
+    cout << name << " checksum: " << sum << ", spare chunks: " << d.spareChunksCount() << endl;
+}
+
+void testSpareChunksBench() {
+    size_t SIZE = 1000;
+    size_t ITERATIONS = 10000000;
+    // с обычным распределителем запас не дает выигрыша, поэтому по умолчанию выключен
+    {
+        Deque<int> d(16);
+        benchFifo("FIFO without spare chunks", d, SIZE, ITERATIONS);
+    }
+    {
+        Deque<int> d(16);
+        d.setMaxSpareChunks(1);
+        benchFifo("FIFO with spare chunks", d, SIZE, ITERATIONS);
+    }
+    // монотонный ресурс не переиспользует память: без запаса каждый новый чанк берет новые байты
+    {
+        std::pmr::monotonic_buffer_resource resource;
+        Smoren::Containers::pmr::Deque<int> d(16, &resource);
+        benchFifo("FIFO monotonic resource without spare chunks", d, SIZE, ITERATIONS);
+    }
+    {
+        std::pmr::monotonic_buffer_resource resource;
+        Smoren::Containers::pmr::Deque<int> d(16, &resource);
+        d.setMaxSpareChunks(1);
+        benchFifo("FIFO monotonic resource with spare chunks", d, SIZE, ITERATIONS);
+    }
+    cout << endl;
+}
+
+void testSegmentsBench() {
+    size_t SIZE = 10000000;
+    Deque<int, 1024> d;
+    for(size_t i=0; i<SIZE; i++) {
+        d.push_back(static_cast<int>(i%1000));
+    }
+    {
+        LOG_DURATION("Sum by iterator");
+        long long sum = 0;
+        for(int x : d) {
+            sum += x;
+        }
+        cout << "Sum by iterator: " << sum << endl;
+    }
+    {
+        LOG_DURATION("Sum by segments");
+        cout << "Sum by segments: " << Smoren::Containers::reduce(d, 0LL) << endl;
+    }
+    {
+        LOG_DURATION("Count by segments");
+        cout << "Count by segments: " << Smoren::Containers::count(d, 7) << endl;
+    }
+    cout << endl;
+}
+
+void testBulkAppendBench() {
+    size_t BATCH = 100000;
+    size_t BATCHES = 100;
+    vector<int> batch(BATCH);
+    for(size_t i=0; i<BATCH; i++) {
+        batch[i] = static_cast<int>(i);
+    }
+    {
+        LOG_DURATION("Deque push_back");
+        Deque<int> d(1024);
+        for(size_t k=0; k<BATCHES; k++) {
+            for(int x : batch) {
+                d.push_back(x);
+            }
+        }
+        cout << "Deque push_back size: " << d.size() << endl;
+    }
+    {
+        LOG_DURATION("Deque append");
+        Deque<int> d(1024);
+        for(size_t k=0; k<BATCHES; k++) {
+            d.append(batch.data(), batch.size());
+        }
+        cout << "Deque append size: " << d.size() << endl;
+    }
+    {
+        LOG_DURATION("vector insert");
+        vector<int> v;
+        for(size_t k=0; k<BATCHES; k++) {
+            v.insert(v.end(), batch.begin(), batch.end());
+        }
+        cout << "vector insert size: " << v.size() << endl;
+    }
+    cout << endl;
+}
+
+void testSpscQueueBench() {
+    const int SIZE = 10000000;
+    {
+        LOG_DURATION("Mutex + Deque producer/consumer");
+        Deque<int, 1024> d;
+        mutex m;
+        thread producer([&]() {
+            for(int i=0; i<SIZE; i++) {
+                lock_guard<mutex> lock(m);
+                d.push_back(i);
+            }
+        });
+        long long sum = 0;
+        for(int received=0; received<SIZE;) {
+            lock_guard<mutex> lock(m);
+            if(!d.empty()) {
+                sum += d[0];
+                d.pop_front();
+                received++;
+            }
+        }
+        producer.join();
+        cout << "Mutex + Deque checksum: " << sum << endl;
+    }
+    {
+        LOG_DURATION("SpscQueue producer/consumer");
+        SpscQueue<int, 1024> q;
+        thread producer([&]() {
+            for(int i=0; i<SIZE; i++) {
+                q.push(i);
+            }
+        });
+        long long sum = 0;
+        for(int received=0, value; received<SIZE;) {
+            if(q.try_pop(value)) {
+                sum += value;
+                received++;
+            }
+        }
+        producer.join();
+        cout << "SpscQueue checksum: " << sum << endl;
+    }
+    {
+        LOG_DURATION("SpscQueue batched producer/consumer");
+        SpscQueue<int, 1024> q;
+        thread producer([&]() {
+            int batch[256];
+            for(int i=0; i<SIZE; i+=256) {
+                for(int j=0; j<256; j++) {
+                    batch[j] = i+j;
+                }
+                q.push_n(batch, min(256, SIZE-i));
+            }
+        });
+        long long sum = 0;
+        int batch[256];
+        for(int received=0; received<SIZE;) {
+            size_t count = q.pop_n(batch, 256);
+            for(size_t j=0; j<count; j++) {
+                sum += batch[j];
+            }
+            received += static_cast<int>(count);
+        }
+        producer.join();
+        cout << "SpscQueue batched checksum: " << sum << endl;
+    }
+    cout << endl;
+}
+
+class MutexDequeTasks {
+public:
+    MutexDequeTasks(): d(256) {}
+
+    void push_back(int value) {
+        lock_guard<mutex> lock(m);
+        d.push_back(value);
+    }
+
+    bool pop_back(int& value) {
+        lock_guard<mutex> lock(m);
+        if(d.empty()) {
+            return false;
+        }
+        value = d[d.size()-1];
+        d.pop_back();
+        return true;
+    }
+
+    bool steal(int& value) {
+        lock_guard<mutex> lock(m);
+        if(d.empty()) {
+            return false;
+        }
+        value = d[0];
+        d.pop_front();
+        return true;
+    }
+
+protected:
+    Deque<int> d;
+    mutex m;
+};
+
+template <typename Tasks>
+void benchWorkStealing(const string& name, size_t thievesCount) {
+    const int TASKS = 2000000;
+    Tasks tasks;
+    atomic<int> processed(0);
+    atomic<int> stolen(0);
+    atomic<bool> done(false);
+    chrono::steady_clock::duration ownerDuration;
+    {
+        LOG_DURATION(name + ", thieves: " + to_string(thievesCount));
+        vector<thread> thieves;
+        for(size_t i=0; i<thievesCount; i++) {
+            thieves.emplace_back([&]() {
+                int value;
+                while(!done.load(memory_order_relaxed)) {
+                    if(tasks.steal(value)) {
+                        stolen.fetch_add(1, memory_order_relaxed);
+                        processed.fetch_add(1, memory_order_relaxed);
+                    }
+                }
+            });
+        }
+
+        int value;
+        auto ownerStart = chrono::steady_clock::now();
+        for(int i=0; i<TASKS; i++) {
+            tasks.push_back(i);
+            if(i%2 == 0 && tasks.pop_back(value)) {
+                processed.fetch_add(1, memory_order_relaxed);
+            }
+        }
+        ownerDuration = chrono::steady_clock::now()-ownerStart;
+
+        while(processed.load() < TASKS) {
+            if(tasks.pop_back(value)) {
+                processed.fetch_add(1, memory_order_relaxed);
+            }
+        }
+        done = true;
+        for(auto& thief : thieves) {
+            thief.join();
+        }
+    }
+    cout << name << ", thieves: " << thievesCount
+         << ", stolen: " << stolen.load()
+         << ", owner ns/op: " << chrono::duration_cast<chrono::nanoseconds>(ownerDuration).count()/(TASKS*3/2)
+         << endl;
+}
+
+void testWorkStealingBench() {
+    size_t cores = thread::hardware_concurrency();
+    size_t maxThieves = cores > 2 ? min<size_t>(4, cores-1) : 1;
+    for(size_t thieves=1; thieves<=maxThieves; thieves++) {
+        benchWorkStealing< WorkStealingDeque<int> >("WorkStealingDeque", thieves);
+        benchWorkStealing<MutexDequeTasks>("Mutex + Deque", thieves);
+    }
+    cout << endl;
+}
+
+void testChunkArenaBench() {
+    const size_t REQUESTS = 10000;
+    const size_t DEQUES = 20;
+    const int ITEMS = 300;
+    {
+        LOG_DURATION("Short-lived deques, default allocator");
+        long long sum = 0;
+        for(size_t r=0; r<REQUESTS; r++) {
+            for(size_t k=0; k<DEQUES; k++) {
+                Deque<int> d(64);
+                for(int i=0; i<ITEMS; i++) {
+                    d.push_back(i);
+                }
+                sum += d[d.size()-1];
+            }
+        }
+        cout << "Default allocator checksum: " << sum << endl;
+    }
+    {
+        LOG_DURATION("Short-lived deques, ChunkArena");
+        ChunkArena arena;
+        long long sum = 0;
+        for(size_t r=0; r<REQUESTS; r++) {
+            for(size_t k=0; k<DEQUES; k++) {
+                Smoren::Containers::pmr::Deque<int> d(64, &arena);
+                for(int i=0; i<ITEMS; i++) {
+                    d.push_back(i);
+                }
+                sum += d[d.size()-1];
+            }
+            arena.reset();
+        }
+        cout << "ChunkArena checksum: " << sum << endl;
+    }
+    cout << endl;
+}
+
+void testMappedDequeBench() {
+    const string PATH = "mapped_deque_bench.bin";
+    const int SIZE = 5000000;
+    remove(PATH.c_str());
+    {
+        LOG_DURATION("MappedDeque fill");
+        MappedDeque<int> d(PATH);
+        for(int i=0; i<SIZE; i++) {
+            d.push_back(i);
+        }
+    }
+    {
+        LOG_DURATION("MappedDeque reopen");
+        MappedDeque<int> d(PATH);
+        cout << "MappedDeque reopened size: " << d.size() << ", front: " << d.front() << ", back: " << d.back() << endl;
+    }
+    remove(PATH.c_str());
+    cout << endl;
+}
+
+void testSpillDequeBench() {
+    const int BACKLOG = 4000000;
+    const int ROUNDS = 2000000;
+    const size_t CHUNK_CAPACITY = 16384;
+
+    SpillDeque<int>::Options options;
+    options.maxResidentChunks = 16;
+    SpillDeque<int> d(CHUNK_CAPACITY, options);
+    {
+        LOG_DURATION("SpillDeque backlog fill");
+        for(int i=0; i<BACKLOG; i++) {
+            d.push_back(i);
+        }
+    }
+    long long sum = 0;
+    {
+        LOG_DURATION("SpillDeque fifo over backlog");
+        for(int i=0; i<ROUNDS; i++) {
+            d.push_back(i);
+            sum += d.front();
+            d.pop_front();
+        }
+    }
+    {
+        LOG_DURATION("SpillDeque random access");
+        mt19937 generator(42);
+        uniform_int_distribution<size_t> distribution(0, d.size()-1);
+        for(int i=0; i<1000; i++) {
+            sum += d[distribution(generator)];
+        }
+    }
+    const SpillDeque<int>::Stats stats = d.stats();
+    cout << "SpillDeque chunks: " << d.chunksCount() << ", resident: " << stats.residentChunks
+         << ", spills: " << stats.spills << ", reloads: " << stats.reloads << ", stalls: " << stats.stalls
+         << " (" << sum << ")" << endl;
+
+    // смешанная нагрузка: чанков в памяти за вычетом уже поставленных на запись не должно быть больше бюджета
+    for(size_t budget : {9, 16}) {
+        SpillDeque<int>::Options mixedOptions;
+        mixedOptions.maxResidentChunks = budget;
+        SpillDeque<int> mixed(1024, mixedOptions);
+        mt19937 generator(1);
+        size_t maxPlanned = 0;
+        size_t maxResident = 0;
+        for(int i=0; i<3000000; i++) {
+            const unsigned op = generator()%10;
+            if(op < 4) {
+                mixed.push_back(i);
+            } else if(op < 6) {
+                mixed.push_front(i);
+            } else if(op < 7 && !mixed.empty()) {
+                mixed.pop_front();
+            } else if(op < 8 && !mixed.empty()) {
+                mixed.pop_back();
+            }
+            const SpillDeque<int>::Stats current = mixed.stats();
+            maxPlanned = max(maxPlanned, current.residentChunks-current.pendingSpills);
+            maxResident = max(maxResident, current.residentChunks);
+        }
+        mixed.wait_idle();
+        const SpillDeque<int>::Stats mixedStats = mixed.stats();
+        cout << "SpillDeque mixed, budget " << budget << ": chunks " << mixed.chunksCount()
+             << ", resident " << mixedStats.residentChunks << ", spills " << mixedStats.spills
+             << ", max resident minus pending " << maxPlanned << ", max resident " << maxResident
+             << ", within budget: " << (maxPlanned <= budget && mixedStats.residentChunks == budget) << endl;
+    }
+    cout << endl;
+}
+
+void testSnapshotBench() {
+    const string PATH = "snapshot_bench.bin";
+    const string LOG_PATH = "snapshot_bench.log";
+    const int SIZE = 10000000;
+
+    Deque<int, 1024> d;
+    for(int i=0; i<SIZE; i++) {
+        d.push_back(i);
+    }
+    {
+        LOG_DURATION("Snapshot text operator<<");
+        ostringstream stream;
+        stream << d;
+        cout << "Snapshot text bytes: " << stream.str().size() << endl;
+    }
+    {
+        LOG_DURATION("Snapshot binary save");
+        const int fd = open(PATH.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        save(d, fd);
+        close(fd);
+    }
+    {
+        LOG_DURATION("Snapshot binary load");
+        Deque<int, 1024> restored;
+        const int fd = open(PATH.c_str(), O_RDONLY);
+        load(restored, fd);
+        close(fd);
+        cout << "Snapshot restored size: " << restored.size() << ", back: " << restored[restored.size()-1] << endl;
+    }
+
+    const int fd = open(LOG_PATH.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    IncrementalSnapshot<int> log(fd);
+    {
+        LOG_DURATION("Snapshot incremental first save");
+        log.save(d);
+    }
+    for(int i=0; i<10000; i++) {
+        d.pop_front();
+        d.push_back(i);
+    }
+    {
+        LOG_DURATION("Snapshot incremental second save");
+        cout << "Snapshot incremental chunks written: " << log.save(d) << " of " << d.chunksCount() << endl;
+    }
+    {
+        // хеши прошлой записи хранятся в памяти, поэтому неизменившийся дек дешевле полного save
+        LOG_DURATION("Snapshot incremental unchanged save");
+        cout << "Snapshot incremental unchanged chunks written: " << log.save(d) << " of " << d.chunksCount() << endl;
+    }
+    {
+        // оборванная последняя запись: load возвращает предыдущую, новый журнал отрезает хвост
+        const off_t complete = lseek(fd, 0, SEEK_END);
+        d.push_back(-1);
+        log.save(d);
+        const off_t torn = complete+(lseek(fd, 0, SEEK_END)-complete)/2;
+        cout << "Snapshot incremental torn tail truncated: " << (ftruncate(fd, torn) == 0) << endl;
+        Deque<int, 1024> restored;
+        IncrementalSnapshot<int>::load(restored, fd);
+        cout << "Snapshot incremental restored previous: " << (restored.size() == d.size()-1) << endl;
+        IncrementalSnapshot<int> reopened(fd);
+        cout << "Snapshot incremental reopened at complete record: " << (lseek(fd, 0, SEEK_END) == complete) << endl;
+    }
+    close(fd);
+    remove(PATH.c_str());
+    remove(LOG_PATH.c_str());
+    cout << endl;
+}
+
+template <typename D>
+void benchInsertErase(const string& name, D& d, size_t position, int operations) {
+    LOG_DURATION(name);
+    for(int i=0; i<operations; i++) {
+        d.insert(d.begin()+position, i);
+        d.erase(d.begin()+position+1);
+    }
+}
+
+void testInsertEraseBench() {
+    const int SIZE = 1000000;
+    const int OPERATIONS = 2000;
+    for(double fraction : {0.01, 0.25, 0.5, 0.75, 0.99}) {
+        const size_t position = static_cast<size_t>(SIZE*fraction);
+        const string suffix = " insert/erase at " + to_string(static_cast<int>(fraction*100)) + "%";
+
+        Deque<int, 1024> d;
+        deque<int> stdDeque;
+        for(int i=0; i<SIZE; i++) {
+            d.push_back(i);
+            stdDeque.push_back(i);
+        }
+        benchInsertErase("Deque" + suffix, d, position, OPERATIONS);
+        benchInsertErase("std::deque" + suffix, stdDeque, position, OPERATIONS);
+    }
+    cout << endl;
+}
+
+void testRingDequeBench() {
+    const size_t WINDOW = 1000;
+    const int SIZE = 50000000;
+    {
+        LOG_DURATION("Deque sliding window");
+        Deque<int, 256> d;
+        long long sum = 0;
+        for(int i=0; i<SIZE; i++) {
+            d.push_back(i);
+            if(d.size() > WINDOW) {
+                d.pop_front();
+            }
+            sum += d[0];
+        }
+        cout << "Deque sliding window checksum: " << sum << endl;
+    }
+    {
+        LOG_DURATION("RingDeque sliding window");
+        RingDeque<int> d(WINDOW);
+        long long sum = 0;
+        for(int i=0; i<SIZE; i++) {
+            d.push_back(i);
+            sum += d[0];
+        }
+        cout << "RingDeque sliding window checksum: " << sum << endl;
+    }
+    cout << endl;
+}
+
+void testSlidingWindowBench() {
+    const size_t WINDOW = 1000;
+    const int SIZE = 500000;
+    mt19937 generator(42);
+    uniform_int_distribution<int> distribution(-1000, 1000);
+    vector<int> ticks(SIZE);
+    for(int& tick : ticks) {
+        tick = distribution(generator);
+    }
+    {
+        LOG_DURATION("Rolling min/max/sum rescan");
+        Deque<int, 256> d;
+        long long checksum = 0;
+        for(int tick : ticks) {
+            d.push_back(tick);
+            if(d.size() > WINDOW) {
+                d.pop_front();
+            }
+            int minimum = d[0], maximum = d[0];
+            long long sum = 0;
+            for(int value : d) {
+                minimum = min(minimum, value);
+                maximum = max(maximum, value);
+                sum += value;
+            }
+            checksum += minimum+maximum+sum;
+        }
+        cout << "Rolling rescan checksum: " << checksum << endl;
+    }
+    {
+        LOG_DURATION("Rolling min/max/sum SlidingWindow");
+        SlidingWindow<int> window(WINDOW);
+        long long checksum = 0;
+        for(int tick : ticks) {
+            window.push_back(tick);
+            checksum += window.min()+window.max()+window.sum();
+        }
+        cout << "Rolling SlidingWindow checksum: " << checksum << endl;
+    }
+    {
+        LOG_DURATION("Rolling max SlidingAggregate");
+        auto maximum = [](int a, int b) { return max(a, b); };
+        SlidingAggregate<int, decltype(maximum)> window(maximum, WINDOW);
+        long long checksum = 0;
+        for(int tick : ticks) {
+            window.push_back(tick);
+            checksum += window.query();
+        }
+        cout << "Rolling SlidingAggregate checksum: " << checksum << endl;
+    }
+    cout << endl;
+}
+
+void testDequeStatsBench() {
+    size_t SIZE = 10000000;
+    cout << "sizeof(Deque<int, 1024>): " << sizeof(Deque<int, 1024>) << endl;
+    cout << "sizeof(Deque<int, 1024, allocator<int>, CountingDequeStats>): "
+         << sizeof(Deque<int, 1024, allocator<int>, CountingDequeStats>) << endl;
+    {
+        LOG_DURATION("Deque push_back/pop_front without stats");
+        Deque<int, 1024> d;
+        for(size_t i=0; i<SIZE; i++) {
+            d.push_back(static_cast<int>(i));
+            if(i % 3 == 0) {
+                d.pop_front();
+            }
+        }
+        cout << d.stats() << endl;
+    }
+    {
+        LOG_DURATION("Deque push_back/pop_front with CountingDequeStats");
+        Deque<int, 1024, allocator<int>, CountingDequeStats> d;
+        for(size_t i=0; i<SIZE; i++) {
+            d.push_back(static_cast<int>(i));
+            if(i % 3 == 0) {
+                d.pop_front();
+            }
+        }
+        cout << d.stats() << endl;
+    }
+    cout << endl;
+}
+
+void testReserveBench() {
+    size_t BURSTS = 2000;
+    size_t BURST = 20000;
+    for(bool reserve : {false, true}) {
+        Deque<int, 1024, allocator<int>, CountingDequeStats> d;
+        size_t burstAllocations = 0;
+        for(size_t burst=0; burst<BURSTS; burst++) {
+            if(reserve) {
+                d.reserve_back(BURST);
+            }
+            const size_t allocations = d.stats().chunkAllocations;
+            {
+                PROFILE_SCOPE(reserve ? "Deque burst push_back after reserve_back" : "Deque burst push_back");
+                for(size_t i=0; i<BURST; i++) {
+                    d.push_back(static_cast<int>(i));
+                }
+            }
+            burstAllocations += d.stats().chunkAllocations-allocations;
+            d.clear();
+        }
+        cout << (reserve ? "With" : "Without") << " reserve_back: " << burstAllocations << " chunk allocations inside bursts" << endl;
+        d.shrink_to_fit();
+        cout << "After shrink_to_fit: " << d.stats() << endl;
+    }
+    cout << endl;
+}
+
+void testCopyMoveBench() {
+    size_t SIZE = 2000000;
+    size_t HANDOFFS = 1000000;
+    {
+        Deque<int, 1024> d;
+        for(size_t i=0; i<SIZE; i++) {
+            d.push_back(static_cast<int>(i));
+        }
+        {
+            LOG_DURATION("Deque copy");
+            Deque<int, 1024> copy(d);
+            cout << "Deque copy size: " << copy.size() << endl;
+        }
+        {
+            LOG_DURATION("Deque move handoff");
+            Deque<int, 1024> stage;
+            for(size_t i=0; i<HANDOFFS; i++) {
+                stage = std::move(d);
+                d = std::move(stage);
+            }
+            cout << "Deque after handoffs: " << d.size() << endl;
+        }
+    }
+    {
+        deque<int> d;
+        for(size_t i=0; i<SIZE; i++) {
+            d.push_back(static_cast<int>(i));
+        }
+        {
+            LOG_DURATION("std::deque copy");
+            deque<int> copy(d);
+            cout << "std::deque copy size: " << copy.size() << endl;
+        }
+        {
+            LOG_DURATION("std::deque move handoff");
+            deque<int> stage;
+            for(size_t i=0; i<HANDOFFS; i++) {
+                stage = std::move(d);
+                d = std::move(stage);
+            }
+            cout << "std::deque after handoffs: " << d.size() << endl;
+        }
+    }
+    cout << endl;
+}
+
+template <typename DequeType>
+long long benchSmallDeques(const string& name, size_t count, size_t elements) {
+    LOG_DURATION(name);
+    long long sum = 0;
+    for(size_t i=0; i<count; i++) {
+        DequeType d;
+        for(size_t j=0; j<elements; j++) {
+            if(j % 2) {
+                d.push_back(static_cast<int>(i+j));
+            } else {
+                d.push_front(static_cast<int>(i+j));
+            }
+        }
+        for(int x : d) {
+            sum += x;
+        }
+    }
+    return sum;
+}
+
+void testSmallDequeBench() {
+    size_t COUNT = 2000000;
+    size_t ELEMENTS = 8;
+    cout << "sizeof(SmallDeque<int, 8>): " << sizeof(SmallDeque<int, 8>) << endl;
+    long long sum = benchSmallDeques<SmallDeque<int, 8>>("SmallDeque<int, 8> create/fill/destroy", COUNT, ELEMENTS);
+    cout << "SmallDeque<int, 8> sum: " << sum << endl;
+    sum = benchSmallDeques<Deque<int, 16>>("Deque<int, 16> create/fill/destroy", COUNT, ELEMENTS);
+    cout << "Deque<int, 16> sum: " << sum << endl;
+    sum = benchSmallDeques<deque<int>>("std::deque<int> create/fill/destroy", COUNT, ELEMENTS);
+    cout << "std::deque<int> sum: " << sum << endl;
+    cout << endl;
+}
+
+template <typename F>
+double measureParallelMilliseconds(F f) {
+    chrono::steady_clock::duration best = chrono::steady_clock::duration::max();
+    for(size_t run=0; run<3; run++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        best = min(best, chrono::steady_clock::now()-start);
+    }
+    return chrono::duration<double, milli>(best).count();
+}
+
+void testParallelAlgorithmsBench() {
+    size_t SIZE = 8000000;
+    // половина элементов добавляется в начало, чтобы оба крайних чанка были заполнены частично
+    Deque<double, 4096> d;
+    for(size_t i=0; i<SIZE; i++) {
+        if(i%2) {
+            d.push_back(static_cast<double>(i));
+        } else {
+            d.push_front(static_cast<double>(i));
+        }
+    }
+    vector<double> output(SIZE);
+    const double last = d[d.size()-1];
+    auto heavy = [](double x) { return sqrt(x)*sin(x)+cos(x); };
+
+    const size_t maxThreads = max<size_t>(ThreadPool::defaultThreadsCount(), 2);
+    vector<size_t> threadsCounts;
+    for(size_t threads=1; threads<maxThreads; threads *= 2) {
+        threadsCounts.push_back(threads);
+    }
+    threadsCounts.push_back(maxThreads);
+
+    map<string, double> baseline;
+    for(size_t threads : threadsCounts) {
+        ThreadPool pool(threads);
+        double reduced = 0;
+        size_t counted = 0;
+        bool found = false;
+        vector<pair<string, double>> results = {
+            {"reduce", measureParallelMilliseconds([&] { reduced = Smoren::Containers::reduce(pool, d, 0.0); })},
+            {"count_if", measureParallelMilliseconds([&] { counted = Smoren::Containers::count_if(pool, d, [](double x) { return sin(x) > 0.5; }); })},
+            {"find_if", measureParallelMilliseconds([&] { found = Smoren::Containers::find_if(pool, d, [last](double x) { return x == last; }) != d.end(); })},
+            {"transform", measureParallelMilliseconds([&] { Smoren::Containers::transform(pool, as_const(d), output.begin(), heavy); })},
+            {"for_each", measureParallelMilliseconds([&] { Smoren::Containers::for_each(pool, d, [](double& x) { x = sqrt(x*x); }); })},
+        };
+        for(const auto& [name, milliseconds] : results) {
+            if(threads == 1) {
+                baseline[name] = milliseconds;
+            }
+            cout << "Parallel " << name << ", threads: " << threads << ": " << milliseconds << " ms"
+                 << ", speedup: " << baseline[name]/milliseconds << endl;
+        }
+        cout << "Sum: " << reduced << ", counted: " << counted << ", found last: " << found << ", output[0]: " << output[0] << endl;
     }
     cout << endl;
 }
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Smoren::Containers {
+    /**
+     * @brief когда MappedDeque сбрасывает изменения на диск
+     */
+    enum class FlushPolicy {
+        Manual, // только при вызове flush() и в деструкторе
+        Async,  // после каждой операции ставит затронутые страницы в очередь на запись (MS_ASYNC)
+        Sync    // после каждой операции дожидается записи затронутых страниц (MS_SYNC)
+    };
+
+    /**
+     * @brief дек тривиально копируемых элементов, хранящийся в отображенном в память файле
+     *
+     * Файл состоит из заголовка и чанков. Каждый чанк занимает целое число страниц,
+     * индекс чанков (кольцо номеров чанков в файле) и список свободных чанков
+     * лежат в заголовке. Повторное открытие файла только отображает его в память,
+     * поэтому время запуска и потребление памяти не зависят от длины очереди.
+     *
+     * Изменяемое состояние заголовка (размер, сдвиг, начало кольца, счетчики чанков)
+     * хранится в двух копиях с порядковыми номерами, действует копия с большим номером.
+     * Операция пишет элемент, записи индекса и списка свободных чанков вне действующих
+     * диапазонов и новое состояние в запасную копию, а затем одной атомарной записью
+     * номера делает ее действующей. Поэтому аварийное завершение процесса на любом шаге
+     * оставляет файл в состоянии до или после операции. От потери питания это защищает
+     * только вместе с FlushPolicy::Sync и в пределах атомарности записи страниц устройством.
+     *
+     * Рост файла переотображает его, что делает недействительными ссылки на элементы.
+     */
+    template <typename T>
+    class MappedDeque {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+    public:
+        struct Options {
+            size_t chunkBytes = 1 << 20;
+            size_t maxChunks = 1 << 16;
+            FlushPolicy flushPolicy = FlushPolicy::Manual;
+        };
+
+        /**
+         * @brief открывает файл path или создает его, если файла нет
+         *
+         * Для существующего файла размеры чанков берутся из заголовка, а из options используется только flushPolicy.
+         */
+        explicit MappedDeque(const std::string& path, const Options& options = Options()):
+            flushPolicy(options.flushPolicy),
+            pageSize(static_cast<size_t>(sysconf(_SC_PAGESIZE))),
+            fd(-1),
+            base(nullptr),
+            mappedBytes(0),
+            state(),
+            sequence(0),
+            activeCopy(0)
+        {
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if(fd < 0) {
+                throwSystemError("open");
+            }
+
+            try {
+                struct stat info;
+                if(fstat(fd, &info) != 0) {
+                    throwSystemError("fstat");
+                }
+                if(info.st_size == 0) {
+                    create(options);
+                } else {
+                    open(static_cast<size_t>(info.st_size));
+                }
+            } catch(...) {
+                unmap();
+                ::close(fd);
+                throw;
+            }
+        }
+
+        MappedDeque(const MappedDeque& d) = delete;
+        MappedDeque& operator =(const MappedDeque& d) = delete;
+
+        ~MappedDeque() {
+            if(base != nullptr) {
+                msync(base, mappedBytes, MS_SYNC);
+            }
+            unmap();
+            ::close(fd);
+        }
+
+        void push_back(const T& value) {
+            State next = state;
+            if(empty() || getItemOffset(next.leftShift+next.size) == 0) {
+                addChunkToBack(next);
+            }
+            T* item = element(next, next.size);
+            std::memcpy(static_cast<void*>(item), &value, sizeof(T));
+            next.size++;
+            commit(next);
+            syncAfterWrite(item);
+        }
+
+        void push_front(const T& value) {
+            State next = state;
+            if(empty() || next.leftShift == 0) {
+                addChunkToFront(next);
+                next.leftShift = header()->chunkCapacity;
+            }
+            T* item = chunkData(next, 0)+next.leftShift-1;
+            std::memcpy(static_cast<void*>(item), &value, sizeof(T));
+            next.leftShift--;
+            next.size++;
+            commit(next);
+            syncAfterWrite(item);
+        }
+
+        void pop_front() {
+            State next = state;
+            next.size--;
+            next.leftShift++;
+            if(next.size == 0) {
+                releaseAllChunks(next);
+            } else if(next.leftShift == header()->chunkCapacity) {
+                removeChunkFromFront(next);
+                next.leftShift = 0;
+            }
+            commit(next);
+            syncAfterWrite(nullptr);
+        }
+
+        void pop_back() {
+            State next = state;
+            next.size--;
+            if(next.size == 0) {
+                releaseAllChunks(next);
+            } else if(getItemOffset(next.leftShift+next.size) == 0) {
+                removeChunkFromBack(next);
+            }
+            commit(next);
+            syncAfterWrite(nullptr);
+        }
+
+        T& operator [](size_t i) {
+            return *element(state, i);
+        }
+
+        const T& operator [](size_t i) const {
+            return *element(state, i);
+        }
+
+        T& front() {
+            return *element(state, 0);
+        }
+
+        T& back() {
+            return *element(state, size()-1);
+        }
+
+        size_t size() const {
+            return state.size;
+        }
+
+        bool empty() const {
+            return !state.size;
+        }
+
+        size_t chunksCount() const {
+            return state.chunksCount;
+        }
+
+        size_t getChunkCapacity() const {
+            return header()->chunkCapacity;
+        }
+
+        /**
+         * @brief дожидается записи всех измененных страниц на диск
+         */
+        void flush() {
+            if(msync(base, mappedBytes, MS_SYNC) != 0) {
+                throwSystemError("msync");
+            }
+        }
+
+    protected:
+        static constexpr uint64_t magic = 0x5145444d4e524d53; // "SMRNMDEQ"
+        static constexpr uint64_t version = 2;
+        // номера чанков в файле хранятся в uint32_t
+        static constexpr uint64_t maxChunksLimit = uint64_t(1) << 32;
+
+        /**
+         * @brief изменяемая часть заголовка
+         */
+        struct State {
+            uint64_t size;
+            uint64_t leftShift;
+            uint64_t mapHead;
+            uint64_t chunksCount;
+            uint64_t slotsCount;
+            uint64_t freeCount;
+        };
+
+        struct StateCopy {
+            std::atomic<uint64_t> sequence;
+            State state;
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "MappedDeque needs lock-free 64-bit atomics");
+
+        struct Header {
+            uint64_t magic;
+            uint64_t version;
+            uint64_t elementSize;
+            uint64_t chunkCapacity;
+            uint64_t chunkBytes;
+            uint64_t maxChunks;
+            uint64_t headerBytes;
+            StateCopy states[2];
+        };
+
+        FlushPolicy flushPolicy;
+        size_t pageSize;
+        int fd;
+        char* base;
+        size_t mappedBytes;
+        // копия действующего состояния, его номер и номер копии в заголовке
+        State state;
+        uint64_t sequence;
+        size_t activeCopy;
+
+        Header* header() const {
+            return reinterpret_cast<Header*>(base);
+        }
+
+        /**
+         * @brief кольцо номеров чанков в файле, в порядке следования чанков в деке
+         */
+        uint32_t* slotMap() const {
+            return reinterpret_cast<uint32_t*>(base+sizeof(Header));
+        }
+
+        /**
+         * @brief стек номеров свободных чанков в файле
+         */
+        uint32_t* freeSlots() const {
+            return slotMap()+header()->maxChunks;
+        }
+
+        T* slotData(uint64_t slot) const {
+            return reinterpret_cast<T*>(base+header()->headerBytes+slot*header()->chunkBytes);
+        }
+
+        T* chunkData(const State& s, uint64_t chunkIndex) const {
+            return slotData(slotMap()[(s.mapHead+chunkIndex) & (header()->maxChunks-1)]);
+        }
+
+        size_t getItemOffset(uint64_t position) const {
+            return position % header()->chunkCapacity;
+        }
+
+        T* element(const State& s, size_t index) const {
+            const uint64_t position = s.leftShift+index;
+            return chunkData(s, position/header()->chunkCapacity)+position%header()->chunkCapacity;
+        }
+
+        /**
+         * @brief делает next действующим состоянием
+         *
+         * Все поля пишутся в запасную копию, и только затем ее номер становится больше номера
+         * действующей. Запись номера — одна выровненная 8-байтовая запись с семантикой release,
+         * поэтому ни процесс, открывший файл после сбоя, ни компилятор не увидят новый номер раньше полей.
+         */
+        void commit(const State& next) {
+            StateCopy& copy = header()->states[activeCopy^1];
+            copy.state = next;
+            copy.sequence.store(sequence+1, std::memory_order_release);
+            state = next;
+            sequence++;
+            activeCopy ^= 1;
+        }
+
+        size_t roundUp(size_t value, size_t alignment) const {
+            return (value+alignment-1)/alignment*alignment;
+        }
+
+        void create(const Options& options) {
+            if(options.chunkBytes < sizeof(T)) {
+                throw std::invalid_argument("chunkBytes is smaller than element size");
+            }
+            if(options.maxChunks > maxChunksLimit) {
+                throw std::invalid_argument("maxChunks is too large");
+            }
+
+            size_t maxChunks = 1;
+            while(maxChunks < options.maxChunks) {
+                maxChunks *= 2;
+            }
+
+            const size_t headerBytes = roundUp(sizeof(Header)+2*maxChunks*sizeof(uint32_t), pageSize);
+            resizeFile(headerBytes);
+            map(headerBytes);
+
+            Header* h = new(base) Header();
+            h->magic = magic;
+            h->version = version;
+            h->elementSize = sizeof(T);
+            h->chunkBytes = roundUp(options.chunkBytes, pageSize);
+            h->chunkCapacity = h->chunkBytes/sizeof(T);
+            h->maxChunks = maxChunks;
+            h->headerBytes = headerBytes;
+            h->states[0].sequence.store(1, std::memory_order_release);
+            sequence = 1;
+            activeCopy = 0;
+            flush();
+        }
+
+        void open(size_t fileBytes) {
+            if(fileBytes < sizeof(Header)) {
+                throw std::runtime_error("file is too small to be a MappedDeque");
+            }
+            map(fileBytes);
+
+            const Header* h = header();
+            if(h->magic != magic || h->version != version) {
+                throw std::runtime_error("file is not a MappedDeque");
+            }
+            if(h->elementSize != sizeof(T)) {
+                throw std::runtime_error("MappedDeque element size mismatch");
+            }
+            validateGeometry(fileBytes);
+
+            const uint64_t sequences[2] = {
+                h->states[0].sequence.load(std::memory_order_acquire),
+                h->states[1].sequence.load(std::memory_order_acquire)
+            };
+            activeCopy = sequences[1] > sequences[0] ? 1 : 0;
+            sequence = sequences[activeCopy];
+            if(sequence == 0) {
+                throw std::runtime_error("MappedDeque header is damaged: no committed state");
+            }
+            state = h->states[activeCopy].state;
+            validateState(fileBytes);
+        }
+
+        /**
+         * @brief проверяет неизменяемые поля заголовка, чтобы поврежденный или чужой файл не привел к выходу за границы
+         */
+        void validateGeometry(size_t fileBytes) const {
+            const Header* h = header();
+            if(h->maxChunks == 0 || (h->maxChunks & (h->maxChunks-1)) != 0 || h->maxChunks > maxChunksLimit) {
+                throw std::runtime_error("MappedDeque header is damaged: maxChunks");
+            }
+            if(h->headerBytes < sizeof(Header)+2*h->maxChunks*sizeof(uint32_t) || h->headerBytes > fileBytes) {
+                throw std::runtime_error("MappedDeque header is damaged: headerBytes");
+            }
+            if(h->chunkBytes == 0 || h->chunkBytes > fileBytes || h->chunkCapacity == 0 || h->chunkCapacity != h->chunkBytes/h->elementSize) {
+                throw std::runtime_error("MappedDeque header is damaged: chunk geometry");
+            }
+        }
+
+        /**
+         * @brief проверяет действующее состояние и номера чанков в индексе и списке свободных чанков
+         */
+        void validateState(size_t fileBytes) const {
+            const Header* h = header();
+            const State& s = state;
+            if(s.slotsCount > h->maxChunks || s.chunksCount > s.slotsCount || s.chunksCount+s.freeCount != s.slotsCount || s.mapHead >= h->maxChunks) {
+                throw std::runtime_error("MappedDeque header is damaged: chunk counters");
+            }
+            if(s.slotsCount > (fileBytes-h->headerBytes)/h->chunkBytes) {
+                throw std::runtime_error("MappedDeque file is truncated");
+            }
+            if(s.chunksCount ? s.leftShift >= h->chunkCapacity : s.leftShift != 0) {
+                throw std::runtime_error("MappedDeque header is damaged: leftShift");
+            }
+            if(s.size > fileBytes/h->elementSize || (s.size && (s.leftShift+s.size-1)/h->chunkCapacity >= s.chunksCount)) {
+                throw std::runtime_error("MappedDeque header is damaged: size");
+            }
+            for(uint64_t i=0; i<s.chunksCount; i++) {
+                if(slotMap()[(s.mapHead+i) & (h->maxChunks-1)] >= s.slotsCount) {
+                    throw std::runtime_error("MappedDeque header is damaged: chunk index");
+                }
+            }
+            for(uint64_t i=0; i<s.freeCount; i++) {
+                if(freeSlots()[i] >= s.slotsCount) {
+                    throw std::runtime_error("MappedDeque header is damaged: free chunks");
+                }
+            }
+        }
+
+        void map(size_t bytes) {
+            void* pointer = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(pointer == MAP_FAILED) {
+                throwSystemError("mmap");
+            }
+            base = static_cast<char*>(pointer);
+            mappedBytes = bytes;
+        }
+
+        void unmap() {
+            if(base != nullptr) {
+                munmap(base, mappedBytes);
+                base = nullptr;
+                mappedBytes = 0;
+            }
+        }
+
+        void resizeFile(size_t bytes) {
+            if(ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+                throwSystemError("ftruncate");
+            }
+        }
+
+        /**
+         * @brief снимает номер свободного чанка со стека next, при необходимости удваивая файл
+         *
+         * Новые номера пишутся в стек выше действующего freeCount, поэтому до commit они не видны.
+         */
+        uint32_t allocateSlot(State& next) {
+            if(next.freeCount == 0) {
+                const Header* h = header();
+                if(next.slotsCount == h->maxChunks) {
+                    throw std::length_error("MappedDeque is full");
+                }
+                const uint64_t newSlotsCount = std::min<uint64_t>(h->maxChunks, next.slotsCount ? next.slotsCount*2 : 1);
+                const size_t newBytes = h->headerBytes+newSlotsCount*h->chunkBytes;
+
+                resizeFile(newBytes);
+                unmap();
+                map(newBytes);
+
+                for(uint64_t slot=newSlotsCount; slot>next.slotsCount; slot--) {
+                    freeSlots()[next.freeCount++] = static_cast<uint32_t>(slot-1);
+                }
+                next.slotsCount = newSlotsCount;
+            }
+            return freeSlots()[--next.freeCount];
+        }
+
+        /**
+         * @brief кладет номер чанка на стек свободных выше действующего freeCount
+         */
+        void releaseSlot(State& next, uint32_t slot) {
+            freeSlots()[next.freeCount++] = slot;
+        }
+
+        void addChunkToBack(State& next) {
+            const uint32_t slot = allocateSlot(next);
+            if(next.chunksCount == 0) {
+                next.leftShift = 0;
+            }
+            slotMap()[(next.mapHead+next.chunksCount) & (header()->maxChunks-1)] = slot;
+            next.chunksCount++;
+        }
+
+        void addChunkToFront(State& next) {
+            const uint32_t slot = allocateSlot(next);
+            const uint64_t newHead = (next.mapHead-1) & (header()->maxChunks-1);
+            slotMap()[newHead] = slot;
+            next.mapHead = newHead;
+            next.chunksCount++;
+        }
+
+        void removeChunkFromFront(State& next) {
+            releaseSlot(next, slotMap()[next.mapHead]);
+            next.mapHead = (next.mapHead+1) & (header()->maxChunks-1);
+            next.chunksCount--;
+        }
+
+        void removeChunkFromBack(State& next) {
+            next.chunksCount--;
+            releaseSlot(next, slotMap()[(next.mapHead+next.chunksCount) & (header()->maxChunks-1)]);
+        }
+
+        void releaseAllChunks(State& next) {
+            while(next.chunksCount) {
+                removeChunkFromBack(next);
+            }
+            next.leftShift = 0;
+        }
+
+        /**
+         * @brief сбрасывает на диск страницу измененного элемента и заголовок согласно flushPolicy
+         */
+        void syncAfterWrite(const T* item) {
+            if(flushPolicy == FlushPolicy::Manual) {
+                return;
+            }
+            const int flags = flushPolicy == FlushPolicy::Sync ? MS_SYNC : MS_ASYNC;
+            if(item != nullptr) {
+                const uintptr_t address = reinterpret_cast<uintptr_t>(item);
+                const uintptr_t page = address/pageSize*pageSize;
+                msync(reinterpret_cast<void*>(page), address+sizeof(T)-page, flags);
+            }
+            msync(base, header()->headerBytes, flags);
+        }
+
+        [[noreturn]] static void throwSystemError(const char* operation) {
+            throw std::system_error(errno, std::generic_category(), operation);
+        }
+    };
+}
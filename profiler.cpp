@@ -1,8 +1,296 @@
 #include "profiler.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace Smoren::Tools {
-    Profiler::Profiler(std::string name) : name(name), timeStart(std::chrono::steady_clock::now()), isStopped(false) {
+    namespace {
+        uint64_t elapsedNanoseconds(std::chrono::steady_clock::duration duration) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+        }
+
+        uint64_t saturatingSub(uint64_t lhs, uint64_t rhs) {
+            return lhs > rhs ? lhs-rhs : 0;
+        }
+
+        uint64_t median(std::vector<uint64_t>& values) {
+            std::nth_element(values.begin(), values.begin()+values.size()/2, values.end());
+            return values[values.size()/2];
+        }
+
+        std::string escapeJson(const std::string& value) {
+            std::string result;
+            for(char c : value) {
+                if(c == '"' || c == '\\') {
+                    result += '\\';
+                    result += c;
+                } else if(static_cast<unsigned char>(c) < 0x20) {
+                    std::ostringstream code;
+                    code << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                    result += code.str();
+                } else {
+                    result += c;
+                }
+            }
+            return result;
+        }
+
+        constexpr size_t calibrationRounds = 1001;
+    }
+
+    Histogram::Histogram(): buckets(), _count(0), _min(UINT64_MAX), _max(0), _sum(0) {
+
+    }
+
+    void Histogram::add(uint64_t value) {
+        ++buckets[bucketIndex(value)];
+        ++_count;
+        _min = std::min(_min, value);
+        _max = std::max(_max, value);
+        _sum += value;
+    }
+
+    uint64_t Histogram::percentile(double percent) const {
+        if(!_count) {
+            return 0;
+        }
+        const double clamped = std::min(std::max(percent, 0.0), 100.0);
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped/100.0*_count+0.999999));
+
+        uint64_t seen = 0;
+        for(size_t i=0; i<bucketsCount; i++) {
+            seen += buckets[i];
+            if(seen >= rank) {
+                return std::min(std::max(bucketMiddle(i), min()), _max);
+            }
+        }
+        return _max;
+    }
+
+    size_t Histogram::bucketIndex(uint64_t value) {
+        if(value < subBuckets) {
+            return value;
+        }
+        const size_t exponent = 63-__builtin_clzll(value);
+        const size_t sub = (value >> (exponent-4))-subBuckets;
+        return (exponent-3)*subBuckets+sub;
+    }
+
+    uint64_t Histogram::bucketMiddle(size_t index) {
+        if(index < subBuckets) {
+            return index;
+        }
+        const size_t exponent = index/subBuckets+3;
+        const uint64_t width = uint64_t(1) << (exponent-4);
+        return (subBuckets+index%subBuckets)*width+width/2;
+    }
+
+    CounterValues& CounterValues::operator +=(const CounterValues& other) {
+        cycles += other.cycles;
+        instructions += other.instructions;
+        cacheMisses += other.cacheMisses;
+        branchMisses += other.branchMisses;
+        return *this;
+    }
+
+    CounterValues CounterValues::operator -(const CounterValues& other) const {
+        CounterValues result;
+        result.cycles = saturatingSub(cycles, other.cycles);
+        result.instructions = saturatingSub(instructions, other.instructions);
+        result.cacheMisses = saturatingSub(cacheMisses, other.cacheMisses);
+        result.branchMisses = saturatingSub(branchMisses, other.branchMisses);
+        return result;
+    }
+
+    PerfCounters::PerfCounters() {
+        descriptors.fill(-1);
+#ifdef __linux__
+        const uint64_t events[] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for(size_t i=0; i<descriptors.size(); i++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = events[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : descriptors[0], 0));
+            if(fd < 0) {
+                for(size_t j=0; j<i; j++) {
+                    close(descriptors[j]);
+                }
+                descriptors.fill(-1);
+                return;
+            }
+            descriptors[i] = fd;
+        }
+        ioctl(descriptors[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(descriptors[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    PerfCounters::~PerfCounters() {
+#ifdef __linux__
+        for(int fd : descriptors) {
+            if(fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    bool PerfCounters::available() const {
+        return descriptors[0] >= 0;
+    }
+
+    CounterValues PerfCounters::read() const {
+        CounterValues result;
+#ifdef __linux__
+        if(!available()) {
+            return result;
+        }
+        uint64_t buffer[1+4];
+        if(::read(descriptors[0], buffer, sizeof(buffer)) == static_cast<ssize_t>(sizeof(buffer)) && buffer[0] == 4) {
+            result.cycles = buffer[1];
+            result.instructions = buffer[2];
+            result.cacheMisses = buffer[3];
+            result.branchMisses = buffer[4];
+        }
+#endif
+        return result;
+    }
 
+    PerfCounters& PerfCounters::forThisThread() {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+    ProfilerRegistry& ProfilerRegistry::instance() {
+        static ProfilerRegistry registry;
+        return registry;
+    }
+
+    ProfilerRegistry::ProfilerRegistry(): reportFormat(ReportFormat::Table) {
+        if(const char* format = std::getenv("SMOREN_PROFILER_REPORT")) {
+            if(std::strcmp(format, "json") == 0) {
+                reportFormat = ReportFormat::Json;
+            } else if(std::strcmp(format, "none") == 0) {
+                reportFormat = ReportFormat::None;
+            }
+        }
+    }
+
+    ProfilerRegistry::~ProfilerRegistry() {
+        report(std::cerr, reportFormat);
+    }
+
+    void ProfilerRegistry::record(const std::string& name, uint64_t nanoseconds, const CounterValues* counters) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ScopeStats& stats = scopes[name];
+        stats.durations.add(nanoseconds);
+        if(counters) {
+            stats.counters += *counters;
+            ++stats.counterSamples;
+        }
+    }
+
+    void ProfilerRegistry::report(std::ostream& stream, ReportFormat format) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(format == ReportFormat::None || scopes.empty()) {
+            return;
+        }
+
+        if(format == ReportFormat::Json) {
+            stream << "[" << std::endl;
+            for(auto it = scopes.begin(); it != scopes.end(); ++it) {
+                const Histogram& h = it->second.durations;
+                stream << "  {\"name\": \"" << escapeJson(it->first) << "\", \"count\": " << h.count()
+                       << ", \"min_ns\": " << h.min() << ", \"median_ns\": " << h.percentile(50)
+                       << ", \"p99_ns\": " << h.percentile(99) << ", \"max_ns\": " << h.max()
+                       << ", \"total_ns\": " << h.sum();
+                if(const uint64_t samples = it->second.counterSamples) {
+                    const CounterValues& c = it->second.counters;
+                    stream << ", \"cycles\": " << c.cycles/samples << ", \"instructions\": " << c.instructions/samples
+                           << ", \"cache_misses\": " << c.cacheMisses/samples << ", \"branch_misses\": " << c.branchMisses/samples;
+                }
+                stream << "}" << (std::next(it) != scopes.end() ? "," : "") << std::endl;
+            }
+            stream << "]" << std::endl;
+            return;
+        }
+
+        size_t nameWidth = 4;
+        for(const auto& [name, stats] : scopes) {
+            nameWidth = std::max(nameWidth, name.size());
+        }
+        stream << std::left << std::setw(nameWidth) << "name" << std::right
+               << std::setw(10) << "count" << std::setw(14) << "min" << std::setw(14) << "median"
+               << std::setw(14) << "p99" << std::setw(14) << "max" << std::setw(14) << "total" << std::endl;
+        for(const auto& [name, stats] : scopes) {
+            const Histogram& h = stats.durations;
+            stream << std::left << std::setw(nameWidth) << name << std::right
+                   << std::setw(10) << h.count() << std::setw(14) << formatDuration(h.min())
+                   << std::setw(14) << formatDuration(h.percentile(50)) << std::setw(14) << formatDuration(h.percentile(99))
+                   << std::setw(14) << formatDuration(h.max()) << std::setw(14) << formatDuration(h.sum()) << std::endl;
+            if(const uint64_t samples = stats.counterSamples) {
+                const CounterValues& c = stats.counters;
+                stream << std::string(nameWidth, ' ') << "  per call: " << c.cycles/samples << " cycles, "
+                       << c.instructions/samples << " instructions, " << c.cacheMisses/samples << " cache misses, "
+                       << c.branchMisses/samples << " branch misses" << std::endl;
+            }
+        }
+    }
+
+    void ProfilerRegistry::setReportFormat(ReportFormat format) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reportFormat = format;
+    }
+
+    std::map<std::string, ScopeStats> ProfilerRegistry::snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return scopes;
+    }
+
+    void ProfilerRegistry::reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        scopes.clear();
+    }
+
+    // -1 — еще не прочитана переменная окружения, 0 — выключены, 1 — включены
+    std::atomic<int> Profiler::countersMode(-1);
+
+    Profiler::Profiler(std::string name, bool print):
+        name(std::move(name)),
+        isStopped(false),
+        print(print),
+        withCounters(hardwareCountersEnabled() && PerfCounters::forThisThread().available())
+    {
+        timerOverhead();
+        if(withCounters) {
+            countersOverhead();
+            countersStart = PerfCounters::forThisThread().read();
+        }
+        timeStart = std::chrono::steady_clock::now();
     }
 
     Profiler::~Profiler() {
@@ -13,10 +301,89 @@ namespace Smoren::Tools {
 
     void Profiler::stop() {
         auto timeFinish = std::chrono::steady_clock::now();
-        auto duration = timeFinish - timeStart;
-        std::cerr << name << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << " ms" << std::endl;
+        CounterValues counters;
+        if(withCounters) {
+            counters = PerfCounters::forThisThread().read()-countersStart-countersOverhead();
+        }
+        const uint64_t duration = saturatingSub(elapsedNanoseconds(timeFinish-timeStart), timerOverhead());
+
+        ProfilerRegistry::instance().record(name, duration, withCounters ? &counters : nullptr);
+        if(print) {
+            std::cerr << name << ": " << formatDuration(duration) << std::endl;
+        }
 
         timeStart = timeFinish;
         isStopped = true;
     }
+
+    void Profiler::enableHardwareCounters(bool enabled) {
+        countersMode = enabled ? 1 : 0;
+    }
+
+    bool Profiler::hardwareCountersEnabled() {
+        int mode = countersMode.load(std::memory_order_relaxed);
+        if(mode < 0) {
+            const char* value = std::getenv("SMOREN_PROFILER_COUNTERS");
+            int expected = -1;
+            countersMode.compare_exchange_strong(expected, value && std::strcmp(value, "1") == 0 ? 1 : 0);
+            mode = countersMode.load(std::memory_order_relaxed);
+        }
+        return mode == 1;
+    }
+
+    uint64_t Profiler::timerOverhead() {
+        static const uint64_t overhead = []() {
+            std::vector<uint64_t> samples(calibrationRounds);
+            for(uint64_t& sample : samples) {
+                const auto start = std::chrono::steady_clock::now();
+                const auto finish = std::chrono::steady_clock::now();
+                sample = elapsedNanoseconds(finish-start);
+            }
+            return median(samples);
+        }();
+        return overhead;
+    }
+
+    CounterValues Profiler::countersOverhead() {
+        static const CounterValues overhead = []() {
+            const PerfCounters& counters = PerfCounters::forThisThread();
+            std::vector<uint64_t> cycles(calibrationRounds), instructions(calibrationRounds);
+            std::vector<uint64_t> cacheMisses(calibrationRounds), branchMisses(calibrationRounds);
+            for(size_t i=0; i<calibrationRounds; i++) {
+                // пустой замер тоже читает часы между показаниями счетчиков
+                const CounterValues start = counters.read();
+                std::chrono::steady_clock::now();
+                std::chrono::steady_clock::now();
+                const CounterValues delta = counters.read()-start;
+                cycles[i] = delta.cycles;
+                instructions[i] = delta.instructions;
+                cacheMisses[i] = delta.cacheMisses;
+                branchMisses[i] = delta.branchMisses;
+            }
+            CounterValues result;
+            result.cycles = median(cycles);
+            result.instructions = median(instructions);
+            result.cacheMisses = median(cacheMisses);
+            result.branchMisses = median(branchMisses);
+            return result;
+        }();
+        return overhead;
+    }
+
+    std::string formatDuration(uint64_t nanoseconds) {
+        std::ostringstream stream;
+        if(nanoseconds < 1000) {
+            stream << nanoseconds << " ns";
+            return stream.str();
+        }
+        stream << std::fixed << std::setprecision(3);
+        if(nanoseconds < 1000000) {
+            stream << nanoseconds/1e3 << " us";
+        } else if(nanoseconds < 1000000000) {
+            stream << nanoseconds/1e6 << " ms";
+        } else {
+            stream << nanoseconds/1e9 << " s";
+        }
+        return stream.str();
+    }
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
 
 namespace Smoren::Tools {
@@ -9,16 +14,163 @@ namespace Smoren::Tools {
     #define UNIQ_ID(lineno) UNIQ_ID_IMPL(lineno)
 
     #define LOG_DURATION(message) \
-        Profiler UNIQ_ID(__LINE__)(message)
+        Smoren::Tools::Profiler UNIQ_ID(__LINE__)(message)
 
+    /**
+     * @brief замеряет область без печати каждого замера: только сводка по имени в конце работы
+     */
+    #define PROFILE_SCOPE(message) \
+        Smoren::Tools::Profiler UNIQ_ID(__LINE__)(message, false)
+
+    /**
+     * @brief гистограмма целых значений с логарифмическими корзинами
+     *
+     * Значения меньше 16 хранятся точно, каждая следующая степень двойки делится на 16 корзин,
+     * так что относительная погрешность перцентилей не больше 1/16, а добавление — O(1) без выделения памяти.
+     */
+    class Histogram {
+    public:
+        static constexpr size_t subBuckets = 16;
+        static constexpr size_t bucketsCount = (64-4+1)*subBuckets;
+
+        Histogram();
+        void add(uint64_t value);
+
+        /**
+         * @brief возвращает оценку перцентиля percent (от 0 до 100); для пустой гистограммы — 0
+         */
+        uint64_t percentile(double percent) const;
+
+        uint64_t count() const { return _count; }
+        uint64_t min() const { return _count ? _min : 0; }
+        uint64_t max() const { return _max; }
+        uint64_t sum() const { return _sum; }
+
+    protected:
+        std::array<uint64_t, bucketsCount> buckets;
+        uint64_t _count;
+        uint64_t _min;
+        uint64_t _max;
+        uint64_t _sum;
+
+        static size_t bucketIndex(uint64_t value);
+        static uint64_t bucketMiddle(size_t index);
+    };
+
+    /**
+     * @brief значения аппаратных счетчиков
+     */
+    struct CounterValues {
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t branchMisses = 0;
+
+        CounterValues& operator +=(const CounterValues& other);
+        CounterValues operator -(const CounterValues& other) const;
+    };
+
+    /**
+     * @brief группа счетчиков perf_event_open текущего потока: такты, инструкции, промахи кэша и предсказателя переходов
+     *
+     * Если ядро или права не позволяют открыть счетчики (или система не Linux), available() возвращает false.
+     */
+    class PerfCounters {
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters& counters) = delete;
+        PerfCounters& operator =(const PerfCounters& counters) = delete;
+
+        bool available() const;
+        CounterValues read() const;
+
+        /**
+         * @brief счетчики вызывающего потока; открываются при первом обращении
+         */
+        static PerfCounters& forThisThread();
+
+    protected:
+        std::array<int, 4> descriptors;
+    };
+
+    enum class ReportFormat {
+        None,
+        Table,
+        Json
+    };
+
+    /**
+     * @brief накопленная статистика замеров с одним именем
+     */
+    struct ScopeStats {
+        Histogram durations;
+        CounterValues counters;
+        uint64_t counterSamples = 0;
+    };
+
+    /**
+     * @brief собирает замеры Profiler по именам и печатает сводку при завершении программы
+     *
+     * Формат сводки задается setReportFormat или переменной окружения SMOREN_PROFILER_REPORT
+     * (table, json, none; по умолчанию table), сводка пишется в std::cerr.
+     */
+    class ProfilerRegistry {
+    public:
+        static ProfilerRegistry& instance();
+
+        ~ProfilerRegistry();
+
+        void record(const std::string& name, uint64_t nanoseconds, const CounterValues* counters);
+        void report(std::ostream& stream, ReportFormat format) const;
+        void setReportFormat(ReportFormat format);
+        std::map<std::string, ScopeStats> snapshot() const;
+        void reset();
+
+    protected:
+        mutable std::mutex mutex;
+        std::map<std::string, ScopeStats> scopes;
+        ReportFormat reportFormat;
+
+        ProfilerRegistry();
+    };
+
+    /**
+     * @brief замер длительности области видимости с наносекундной точностью
+     *
+     * Собственные накладные расходы (чтение часов и счетчиков) измеряются один раз
+     * при первом замере и вычитаются из каждого результата.
+     * Аппаратные счетчики включаются enableHardwareCounters или переменной окружения SMOREN_PROFILER_COUNTERS=1.
+     */
     class Profiler {
     public:
-        Profiler(std::string name);
+        Profiler(std::string name, bool print = true);
         ~Profiler();
         void stop();
+
+        static void enableHardwareCounters(bool enabled);
+        static bool hardwareCountersEnabled();
+
+        /**
+         * @brief накладные расходы пустого замера: наносекунды и показания счетчиков
+         */
+        static uint64_t timerOverhead();
+        static CounterValues countersOverhead();
+
     protected:
         std::string name;
         std::chrono::time_point<std::chrono::steady_clock> timeStart;
         bool isStopped;
+        bool print;
+        bool withCounters;
+        CounterValues countersStart;
+
+        static std::atomic<int> countersMode;
     };
+
+    /**
+     * @brief форматирует длительность в наносекундах с подходящей единицей измерения
+     */
+    std::string formatDuration(uint64_t nanoseconds);
 }
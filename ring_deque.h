@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "deque.h"
+
+namespace Smoren::Containers {
+    /**
+     * @brief что делает RingDeque при добавлении в заполненный дек
+     */
+    enum class OverflowPolicy {
+        OverwriteOldest, // вытесняет элемент с противоположного конца
+        Reject           // не добавляет элемент и возвращает false
+    };
+
+    /**
+     * @brief дек фиксированной вместимости на кольцевом буфере
+     *
+     * Память под элементы выделяется один раз в конструкторе, размером со степень двойки
+     * не меньше вместимости, поэтому индексация сводится к маске, а добавление
+     * и удаление с обоих концов не выделяют памяти.
+     *
+     * push_back в заполненный дек с политикой OverwriteOldest удаляет первый элемент,
+     * push_front — последний; так удобно хранить окно последних N значений.
+     */
+    template <typename T, OverflowPolicy Policy = OverflowPolicy::OverwriteOldest, typename Allocator = std::allocator<T>>
+    class RingDeque : protected ChunkStorage<T, 0, Allocator> {
+        using Storage = ChunkStorage<T, 0, Allocator>;
+        using Storage::data;
+
+    public:
+        template <bool IsConst>
+        class Iterator;
+
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+        using allocator_type = Allocator;
+
+        explicit RingDeque(size_t capacity, const Allocator& allocator = Allocator()):
+            Storage(bufferSizeFor(capacity), allocator),
+            limit(capacity),
+            mask(bufferSizeFor(capacity)-1),
+            head(0),
+            _size(0)
+        {
+            if(capacity == 0) {
+                throw std::invalid_argument("RingDeque capacity must be positive");
+            }
+        }
+
+        RingDeque(const RingDeque& d) = delete;
+        RingDeque& operator =(const RingDeque& d) = delete;
+
+        ~RingDeque() {
+            clear();
+        }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, _size); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, _size); }
+
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        /**
+         * @brief создает элемент в конце; возвращает false, если дек заполнен и политика Reject
+         */
+        template <typename... Args>
+        bool emplace_back(Args&&... args) {
+            if(full()) {
+                if constexpr(Policy == OverflowPolicy::Reject) {
+                    return false;
+                } else {
+                    // аргументы могут ссылаться на вытесняемый элемент
+                    T value(std::forward<Args>(args)...);
+                    pop_front();
+                    new(slot(_size)) T(std::move(value));
+                    ++_size;
+                    return true;
+                }
+            }
+            new(slot(_size)) T(std::forward<Args>(args)...);
+            ++_size;
+            return true;
+        }
+
+        /**
+         * @brief создает элемент в начале; возвращает false, если дек заполнен и политика Reject
+         */
+        template <typename... Args>
+        bool emplace_front(Args&&... args) {
+            if(full()) {
+                if constexpr(Policy == OverflowPolicy::Reject) {
+                    return false;
+                } else {
+                    T value(std::forward<Args>(args)...);
+                    pop_back();
+                    new(slot(mask)) T(std::move(value));
+                    --head;
+                    ++_size;
+                    return true;
+                }
+            }
+            new(slot(mask)) T(std::forward<Args>(args)...);
+            --head;
+            ++_size;
+            return true;
+        }
+
+        bool push_back(const T& value) {
+            return emplace_back(value);
+        }
+
+        bool push_back(T&& value) {
+            return emplace_back(std::move(value));
+        }
+
+        bool push_front(const T& value) {
+            return emplace_front(value);
+        }
+
+        bool push_front(T&& value) {
+            return emplace_front(std::move(value));
+        }
+
+        void pop_front() {
+            slot(0)->~T();
+            ++head;
+            --_size;
+        }
+
+        void pop_back() {
+            --_size;
+            slot(_size)->~T();
+        }
+
+        void clear() {
+            if constexpr(!std::is_trivially_destructible_v<T>) {
+                for(size_t i=0; i<_size; i++) {
+                    slot(i)->~T();
+                }
+            }
+            head = 0;
+            _size = 0;
+        }
+
+        T& operator [](size_t i) {
+            return *slot(i);
+        }
+
+        const T& operator [](size_t i) const {
+            return *slot(i);
+        }
+
+        T& front() { return *slot(0); }
+        T& back() { return *slot(_size-1); }
+
+        const T& front() const { return *slot(0); }
+        const T& back() const { return *slot(_size-1); }
+
+        size_t size() const {
+            return _size;
+        }
+
+        bool empty() const {
+            return !_size;
+        }
+
+        bool full() const {
+            return _size == limit;
+        }
+
+        size_t capacity() const {
+            return limit;
+        }
+
+        /**
+         * @brief вызывает f(first, last) для одного или двух непрерывных участков элементов по порядку
+         */
+        template <typename F>
+        void for_each_segment(F f) {
+            forEachSegment(*this, f);
+        }
+
+        template <typename F>
+        void for_each_segment(F f) const {
+            forEachSegment(*this, f);
+        }
+
+        friend std::ostream& operator <<(std::ostream& stream, const RingDeque& d) {
+            return stream << "<" << Smoren::Tools::join(d, ", ") << ">";
+        }
+
+    protected:
+        size_t limit;
+        size_t mask;
+        // номер первого элемента; растет и убывает без ограничений, в буфер попадает через маску
+        size_t head;
+        size_t _size;
+
+        static size_t bufferSizeFor(size_t capacity) {
+            size_t size = 1;
+            while(size < capacity) {
+                size *= 2;
+            }
+            return size;
+        }
+
+        T* slot(size_t index) {
+            return data()+((head+index) & mask);
+        }
+
+        const T* slot(size_t index) const {
+            return data()+((head+index) & mask);
+        }
+
+        template <typename Self, typename F>
+        static void forEachSegment(Self& d, F& f) {
+            if(d.empty()) {
+                return;
+            }
+            auto first = d.slot(0);
+            const size_t firstPart = std::min(d._size, d.mask+1-(d.head & d.mask));
+            f(first, first+firstPart);
+            if(firstPart < d._size) {
+                auto second = d.data();
+                f(second, second+(d._size-firstPart));
+            }
+        }
+    };
+
+    /**
+     * @brief итератор произвольного доступа по RingDeque: номер элемента и указатель на дек
+     */
+    template <typename T, OverflowPolicy Policy, typename Allocator>
+    template <bool IsConst>
+    class RingDeque<T, Policy, Allocator>::Iterator {
+        using Container = std::conditional_t<IsConst, const RingDeque, RingDeque>;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
+
+        Iterator(): container(nullptr), index(0) {}
+
+        Iterator(Container* container, size_t index): container(container), index(index) {}
+
+        template <bool WasConst, typename = std::enable_if_t<IsConst && !WasConst>>
+        Iterator(const Iterator<WasConst>& it): container(it.container), index(it.index) {}
+
+        reference operator*() const { return (*container)[index]; }
+        pointer operator->() const { return &(*container)[index]; }
+        reference operator[](difference_type n) const { return (*container)[index+n]; }
+
+        Iterator& operator++() { ++index; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++index; return tmp; }
+        Iterator& operator--() { --index; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --index; return tmp; }
+
+        Iterator& operator+=(difference_type n) { index += n; return *this; }
+        Iterator& operator-=(difference_type n) { index -= n; return *this; }
+
+        friend Iterator operator+(Iterator it, difference_type n) { return it += n; }
+        friend Iterator operator+(difference_type n, Iterator it) { return it += n; }
+        friend Iterator operator-(Iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+            return static_cast<difference_type>(lhs.index)-static_cast<difference_type>(rhs.index);
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) { return lhs.index == rhs.index; }
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) { return lhs.index != rhs.index; }
+        friend bool operator<(const Iterator& lhs, const Iterator& rhs) { return lhs.index < rhs.index; }
+        friend bool operator>(const Iterator& lhs, const Iterator& rhs) { return lhs.index > rhs.index; }
+        friend bool operator<=(const Iterator& lhs, const Iterator& rhs) { return lhs.index <= rhs.index; }
+        friend bool operator>=(const Iterator& lhs, const Iterator& rhs) { return lhs.index >= rhs.index; }
+
+    private:
+        template <bool> friend class Iterator;
+
+        Container* container;
+        size_t index;
+    };
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "deque.h"
+
+namespace Smoren::Containers {
+    /**
+     * @brief скользящее окно чисел с минимумом, максимумом, суммой, средним и дисперсией за O(1)
+     *
+     * Значения окна хранятся в деке. Для минимума и максимума поддерживаются монотонные деки
+     * кандидатов: при добавлении с конца снимаются кандидаты, которые уже никогда не станут
+     * экстремумом, поэтому каждое значение попадает в них и покидает их не больше одного раза.
+     * Сумма ведется нарастающим итогом, среднее и дисперсия — по формулам Уэлфорда.
+     *
+     * Если windowSize больше нуля, push_back сам удаляет самое старое значение, когда окно переполнено.
+     * Для окна по времени вызывающий сам удаляет устаревшие значения через pop_front.
+     */
+    template <typename T, size_t ChunkCapacity = 256>
+    class SlidingWindow {
+        static_assert(std::is_arithmetic_v<T>, "T must be arithmetic");
+
+    public:
+        using Sum = std::conditional_t<std::is_integral_v<T>, long long, double>;
+
+        explicit SlidingWindow(size_t windowSize = 0):
+            windowSize(windowSize),
+            _sum(0),
+            _mean(0),
+            m2(0)
+        {}
+
+        void push_back(T value) {
+            if(windowSize && values.size() == windowSize) {
+                pop_front();
+            }
+
+            values.push_back(value);
+            while(!minCandidates.empty() && value < minCandidates[minCandidates.size()-1]) {
+                minCandidates.pop_back();
+            }
+            minCandidates.push_back(value);
+            while(!maxCandidates.empty() && maxCandidates[maxCandidates.size()-1] < value) {
+                maxCandidates.pop_back();
+            }
+            maxCandidates.push_back(value);
+
+            _sum += value;
+            const double delta = value-_mean;
+            _mean += delta/values.size();
+            m2 += delta*(value-_mean);
+        }
+
+        void pop_front() {
+            const T value = values[0];
+            values.pop_front();
+            if(minCandidates[0] == value) {
+                minCandidates.pop_front();
+            }
+            if(maxCandidates[0] == value) {
+                maxCandidates.pop_front();
+            }
+
+            _sum -= value;
+            if(values.empty()) {
+                _mean = m2 = 0;
+                return;
+            }
+            const double delta = value-_mean;
+            _mean -= delta/values.size();
+            m2 -= delta*(value-_mean);
+        }
+
+        T min() const {
+            return minCandidates[0];
+        }
+
+        T max() const {
+            return maxCandidates[0];
+        }
+
+        Sum sum() const {
+            return _sum;
+        }
+
+        double mean() const {
+            return _mean;
+        }
+
+        /**
+         * @brief возвращает выборочную дисперсию (с делителем size()-1)
+         */
+        double variance() const {
+            return values.size() > 1 ? std::max(0.0, m2/(values.size()-1)) : 0.0;
+        }
+
+        T front() const {
+            return values[0];
+        }
+
+        T back() const {
+            return values[values.size()-1];
+        }
+
+        T operator [](size_t i) const {
+            return values[i];
+        }
+
+        size_t size() const {
+            return values.size();
+        }
+
+        bool empty() const {
+            return values.empty();
+        }
+
+        const Deque<T, ChunkCapacity>& getValues() const {
+            return values;
+        }
+
+    protected:
+        size_t windowSize;
+        Deque<T, ChunkCapacity> values;
+        Deque<T, ChunkCapacity> minCandidates;
+        Deque<T, ChunkCapacity> maxCandidates;
+
+        Sum _sum;
+        double _mean;
+        double m2;
+    };
+
+    /**
+     * @brief скользящее окно со сверткой произвольной ассоциативной операцией за O(1) амортизированно
+     *
+     * Схема двух стеков в одном деке: элементы [0, split) образуют передний стек, и каждый
+     * хранит свертку себя и всех следующих за ним до split; для элементов [split, size())
+     * ведется одна свертка backAggregate. Когда передний стек пустеет, pop_front пересчитывает
+     * свертки всех элементов с конца, так что каждый элемент пересчитывается один раз.
+     * Коммутативность операции не требуется.
+     */
+    template <typename T, typename Op, size_t ChunkCapacity = 256>
+    class SlidingAggregate {
+    public:
+        explicit SlidingAggregate(Op op = Op(), size_t windowSize = 0):
+            op(std::move(op)),
+            windowSize(windowSize),
+            split(0)
+        {}
+
+        void push_back(const T& value) {
+            if(windowSize && entries.size() == windowSize) {
+                pop_front();
+            }
+            entries.push_back({value, value});
+            backAggregate = backAggregate ? op(*backAggregate, value) : value;
+        }
+
+        void pop_front() {
+            if(split == 0) {
+                flip();
+            }
+            entries.pop_front();
+            split--;
+        }
+
+        /**
+         * @brief возвращает свертку всех элементов окна по порядку; окно не должно быть пустым
+         */
+        T query() const {
+            if(split == 0) {
+                return *backAggregate;
+            }
+            return backAggregate ? op(entries[0].aggregate, *backAggregate) : entries[0].aggregate;
+        }
+
+        const T& front() const {
+            return entries[0].value;
+        }
+
+        size_t size() const {
+            return entries.size();
+        }
+
+        bool empty() const {
+            return entries.empty();
+        }
+
+    protected:
+        struct Entry {
+            T value;
+            T aggregate;
+        };
+
+        Op op;
+        size_t windowSize;
+        Deque<Entry, ChunkCapacity> entries;
+        size_t split;
+        std::optional<T> backAggregate;
+
+        /**
+         * @brief переносит все элементы в передний стек, пересчитывая свертки с конца
+         */
+        void flip() {
+            const size_t count = entries.size();
+            for(size_t i=count; i>0; i--) {
+                Entry& entry = entries[i-1];
+                entry.aggregate = i == count ? entry.value : op(entry.value, entries[i].aggregate);
+            }
+            split = count;
+            backAggregate.reset();
+        }
+    };
+}
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "deque.h"
+
+namespace Smoren::Containers {
+    /**
+     * @brief дек, первые InlineCapacity элементов которого хранятся прямо в объекте
+     *
+     * Пока элементов не больше InlineCapacity, они лежат во встроенном кольцевом буфере,
+     * и дек не обращается к аллокатору ни при создании, ни при добавлении и удалении.
+     * При переполнении элементы переезжают во вложенный Deque, и дальше работает он.
+     * Когда дек снова пустеет, он возвращается к встроенному буферу, а вложенный Deque
+     * сохраняет запасной чанк для следующего роста.
+     *
+     * Переезд во вложенный Deque делает недействительными ссылки и итераторы.
+     */
+    template <typename T, size_t InlineCapacity = 8, size_t ChunkCapacity = chunkCapacityForBytes<T>(4096), typename Allocator = std::allocator<T>>
+    class SmallDeque {
+        static_assert(InlineCapacity > 0, "InlineCapacity must be positive");
+        static_assert(ChunkCapacity > 0, "ChunkCapacity must be positive");
+
+    public:
+        template <bool IsConst>
+        class Iterator;
+
+        using value_type = T;
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+        using allocator_type = Allocator;
+        using LargeDeque = Deque<T, ChunkCapacity, Allocator>;
+
+        static constexpr size_t inlineCapacity = InlineCapacity;
+
+        SmallDeque(): SmallDeque(Allocator()) {}
+
+        explicit SmallDeque(const Allocator& allocator):
+            head(0),
+            inlineSize(0),
+            spilled(false),
+            large(allocator)
+        {
+            large.setMaxSpareChunks(1);
+        }
+
+        SmallDeque(const SmallDeque& d):
+            SmallDeque(std::allocator_traits<Allocator>::select_on_container_copy_construction(d.get_allocator()))
+        {
+            if(d.spilled) {
+                large = d.large;
+                spilled = true;
+            } else {
+                copyInline(d);
+            }
+        }
+
+        SmallDeque(SmallDeque&& d) noexcept(std::is_nothrow_move_constructible_v<T>):
+            SmallDeque(d.large.get_allocator())
+        {
+            takeOver(d);
+        }
+
+        SmallDeque& operator =(const SmallDeque& d) {
+            if(this != &d) {
+                clear();
+                if(d.spilled) {
+                    large = d.large;
+                    spilled = true;
+                } else {
+                    copyInline(d);
+                }
+            }
+            return *this;
+        }
+
+        SmallDeque& operator =(SmallDeque&& d) noexcept(std::is_nothrow_move_constructible_v<T>) {
+            if(this != &d) {
+                clear();
+                takeOver(d);
+            }
+            return *this;
+        }
+
+        ~SmallDeque() {
+            clear();
+        }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, size()); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, size()); }
+
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            if(spilled) {
+                return large.emplace_back(std::forward<Args>(args)...);
+            }
+            if(inlineSize == InlineCapacity) {
+                // аргументы могут ссылаться на элементы, которые переедут
+                T value(std::forward<Args>(args)...);
+                return spill(std::move(value), false);
+            }
+            T* position = slot(inlineSize);
+            new(position) T(std::forward<Args>(args)...);
+            ++inlineSize;
+            return *position;
+        }
+
+        template <typename... Args>
+        T& emplace_front(Args&&... args) {
+            if(spilled) {
+                return large.emplace_front(std::forward<Args>(args)...);
+            }
+            if(inlineSize == InlineCapacity) {
+                T value(std::forward<Args>(args)...);
+                return spill(std::move(value), true);
+            }
+            const size_t position = head ? head-1 : InlineCapacity-1;
+            new(data()+position) T(std::forward<Args>(args)...);
+            head = position;
+            ++inlineSize;
+            return data()[position];
+        }
+
+        void push_back(const T& value) {
+            emplace_back(value);
+        }
+
+        void push_back(T&& value) {
+            emplace_back(std::move(value));
+        }
+
+        void push_front(const T& value) {
+            emplace_front(value);
+        }
+
+        void push_front(T&& value) {
+            emplace_front(std::move(value));
+        }
+
+        void pop_front() {
+            if(spilled) {
+                large.pop_front();
+                spilled = !large.empty();
+                return;
+            }
+            slot(0)->~T();
+            head = head+1 == InlineCapacity ? 0 : head+1;
+            --inlineSize;
+        }
+
+        void pop_back() {
+            if(spilled) {
+                large.pop_back();
+                spilled = !large.empty();
+                return;
+            }
+            --inlineSize;
+            slot(inlineSize)->~T();
+        }
+
+        void clear() {
+            if(spilled) {
+                large.clear();
+                spilled = false;
+                return;
+            }
+            if constexpr(!std::is_trivially_destructible_v<T>) {
+                for(size_t i=0; i<inlineSize; i++) {
+                    slot(i)->~T();
+                }
+            }
+            head = 0;
+            inlineSize = 0;
+        }
+
+        T& operator [](size_t i) {
+            return spilled ? large[i] : *slot(i);
+        }
+
+        const T& operator [](size_t i) const {
+            return spilled ? large[i] : *slot(i);
+        }
+
+        T& front() { return (*this)[0]; }
+        T& back() { return (*this)[size()-1]; }
+
+        const T& front() const { return (*this)[0]; }
+        const T& back() const { return (*this)[size()-1]; }
+
+        size_t size() const {
+            return spilled ? large.size() : inlineSize;
+        }
+
+        bool empty() const {
+            return !size();
+        }
+
+        /**
+         * @brief возвращает true, пока элементы хранятся во встроенном буфере
+         */
+        bool is_inline() const {
+            return !spilled;
+        }
+
+        allocator_type get_allocator() const {
+            return large.get_allocator();
+        }
+
+        /**
+         * @brief вызывает f(first, last) для каждого непрерывного участка элементов по порядку
+         */
+        template <typename F>
+        void for_each_segment(F f) {
+            forEachSegment(*this, f);
+        }
+
+        template <typename F>
+        void for_each_segment(F f) const {
+            forEachSegment(*this, f);
+        }
+
+        friend std::ostream& operator <<(std::ostream& stream, const SmallDeque& d) {
+            return stream << "<" << Smoren::Tools::join(d, ", ") << ">";
+        }
+
+    protected:
+        alignas(T) unsigned char buffer[InlineCapacity*sizeof(T)];
+        size_t head;
+        size_t inlineSize;
+        bool spilled;
+        LargeDeque large;
+
+        T* data() {
+            return reinterpret_cast<T*>(buffer);
+        }
+
+        const T* data() const {
+            return reinterpret_cast<const T*>(buffer);
+        }
+
+        T* slot(size_t index) {
+            const size_t position = head+index;
+            return data()+(position < InlineCapacity ? position : position-InlineCapacity);
+        }
+
+        const T* slot(size_t index) const {
+            const size_t position = head+index;
+            return data()+(position < InlineCapacity ? position : position-InlineCapacity);
+        }
+
+        /**
+         * @brief переносит элементы встроенного буфера во вложенный дек и добавляет value в начало или в конец
+         *
+         * Пустой Deque кладет первый элемент у того края чанка, в сторону которого дек растет,
+         * поэтому при переполнении спереди элементы буфера добавляются в начало с последнего,
+         * и они вместе с value помещаются в один чанк.
+         * Элементы буфера перемещаются, если перемещение не бросает исключений, иначе копируются,
+         * так что при исключении встроенный буфер остается нетронутым.
+         */
+        T& spill(T&& value, bool front) {
+            try {
+                if(front) {
+                    for(size_t i=inlineSize; i>0; i--) {
+                        large.emplace_front(std::move_if_noexcept(*slot(i-1)));
+                    }
+                    large.emplace_front(std::move(value));
+                } else {
+                    auto transfer = [this](T* first, T* last) {
+                        if constexpr(std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>) {
+                            large.append(std::make_move_iterator(first), std::make_move_iterator(last));
+                        } else {
+                            large.append(first, last);
+                        }
+                    };
+                    forEachSegment(*this, transfer);
+                    large.emplace_back(std::move(value));
+                }
+            } catch(...) {
+                large.clear();
+                throw;
+            }
+            clear();
+            spilled = true;
+            return front ? large[0] : large[large.size()-1];
+        }
+
+        void copyInline(const SmallDeque& d) {
+            for(size_t i=0; i<d.inlineSize; i++) {
+                emplace_back(*d.slot(i));
+            }
+        }
+
+        /**
+         * @brief забирает элементы d; дек должен быть пуст и во встроенном режиме
+         */
+        void takeOver(SmallDeque& d) {
+            if(d.spilled) {
+                large = std::move(d.large);
+                spilled = true;
+                d.spilled = false;
+                return;
+            }
+            for(size_t i=0; i<d.inlineSize; i++) {
+                new(slot(i)) T(std::move(*d.slot(i)));
+                ++inlineSize;
+            }
+            d.clear();
+        }
+
+        template <typename Self, typename F>
+        static void forEachSegment(Self& d, F& f) {
+            if(d.spilled) {
+                d.large.for_each_segment(f);
+                return;
+            }
+            if(!d.inlineSize) {
+                return;
+            }
+            auto first = d.slot(0);
+            const size_t firstPart = std::min(d.inlineSize, InlineCapacity-d.head);
+            f(first, first+firstPart);
+            if(firstPart < d.inlineSize) {
+                auto second = d.data();
+                f(second, second+(d.inlineSize-firstPart));
+            }
+        }
+    };
+
+    /**
+     * @brief итератор произвольного доступа по SmallDeque: номер элемента и указатель на дек
+     */
+    template <typename T, size_t InlineCapacity, size_t ChunkCapacity, typename Allocator>
+    template <bool IsConst>
+    class SmallDeque<T, InlineCapacity, ChunkCapacity, Allocator>::Iterator {
+        using Container = std::conditional_t<IsConst, const SmallDeque, SmallDeque>;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
+
+        Iterator(): container(nullptr), index(0) {}
+
+        Iterator(Container* container, size_t index): container(container), index(index) {}
+
+        template <bool WasConst, typename = std::enable_if_t<IsConst && !WasConst>>
+        Iterator(const Iterator<WasConst>& it): container(it.container), index(it.index) {}
+
+        reference operator*() const { return (*container)[index]; }
+        pointer operator->() const { return &(*container)[index]; }
+        reference operator[](difference_type n) const { return (*container)[index+n]; }
+
+        Iterator& operator++() { ++index; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++index; return tmp; }
+        Iterator& operator--() { --index; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --index; return tmp; }
+
+        Iterator& operator+=(difference_type n) { index += n; return *this; }
+        Iterator& operator-=(difference_type n) { index -= n; return *this; }
+
+        friend Iterator operator+(Iterator it, difference_type n) { return it += n; }
+        friend Iterator operator+(difference_type n, Iterator it) { return it += n; }
+        friend Iterator operator-(Iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+            return static_cast<difference_type>(lhs.index)-static_cast<difference_type>(rhs.index);
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) { return lhs.index == rhs.index; }
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) { return lhs.index != rhs.index; }
+        friend bool operator<(const Iterator& lhs, const Iterator& rhs) { return lhs.index < rhs.index; }
+        friend bool operator>(const Iterator& lhs, const Iterator& rhs) { return lhs.index > rhs.index; }
+        friend bool operator<=(const Iterator& lhs, const Iterator& rhs) { return lhs.index <= rhs.index; }
+        friend bool operator>=(const Iterator& lhs, const Iterator& rhs) { return lhs.index >= rhs.index; }
+
+    private:
+        template <bool> friend class Iterator;
+
+        Container* container;
+        size_t index;
+    };
+}
@@ -0,0 +1,554 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "deque.h"
+
+namespace Smoren::Containers {
+    /**
+     * @brief дек с ограниченным количеством чанков в памяти, вытесняющий холодные чанки в файл
+     *
+     * Чанки у обоих концов (hotChunks штук) всегда находятся в памяти. Еще prefetchChunks
+     * чанков за ними подгружаются из файла заранее, по мере приближения к ним начала или конца дека.
+     * Когда чанков в памяти больше maxResidentChunks, чанк, только что ушедший из теплой зоны,
+     * записывается в файл фоновым потоком, после чего его память освобождается.
+     * operator[] по вытесненному чанку читает его синхронно.
+     *
+     * Ссылки на элементы действительны только до следующей операции с деком.
+     * T должен быть тривиально копируемым.
+     */
+    template <typename T>
+    class SpillDeque {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+    public:
+        struct Options {
+            size_t maxResidentChunks = 64;
+            size_t hotChunks = 2;
+            size_t prefetchChunks = 2;
+            std::string spillDirectory = "/tmp";
+        };
+
+        /**
+         * @brief счетчики для подбора бюджета памяти
+         */
+        struct Stats {
+            size_t spills;         // чанков записано в файл и выгружено
+            size_t reloads;        // чанков прочитано из файла
+            size_t stalls;         // раз операция ждала фоновый поток или читала файл синхронно
+            size_t residentChunks; // чанков в памяти сейчас
+            size_t pendingSpills;  // из них поставлено в очередь на запись и еще не выгружено
+        };
+
+        explicit SpillDeque(size_t chunkCapacity, const Options& options = Options()):
+            chunkCapacity(chunkCapacity),
+            options(options),
+            leftShift(0),
+            _size(0),
+            firstChunkId(0),
+            nextSlot(0),
+            fd(-1),
+            residentCount(0),
+            pendingSpills(0),
+            spills(0),
+            reloads(0),
+            stalls(0),
+            working(false),
+            stopping(false)
+        {
+            const size_t warmChunks = this->options.hotChunks+this->options.prefetchChunks;
+            this->options.maxResidentChunks = std::max(this->options.maxResidentChunks, 2*warmChunks+1);
+
+            spillPath = this->options.spillDirectory+"/smoren-deque-spill-XXXXXX";
+            fd = mkstemp(&spillPath[0]);
+            if(fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "mkstemp");
+            }
+            worker = std::thread(&SpillDeque::workerLoop, this);
+        }
+
+        SpillDeque(const SpillDeque& d) = delete;
+        SpillDeque& operator =(const SpillDeque& d) = delete;
+
+        ~SpillDeque() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            jobAvailable.notify_one();
+            worker.join();
+
+            while(!chunks.empty()) {
+                freeChunkData(chunks[chunks.size()-1]);
+                delete chunks[chunks.size()-1];
+                chunks.pop_back();
+            }
+            ::close(fd);
+            ::unlink(spillPath.c_str());
+        }
+
+        void push_back(const T& value) {
+            if(empty() || (leftShift+_size)%chunkCapacity == 0) {
+                addChunkToBack();
+            }
+            const size_t position = leftShift+_size;
+            chunks[chunks.size()-1]->data[position%chunkCapacity] = value;
+            _size++;
+        }
+
+        void push_front(const T& value) {
+            if(empty() || leftShift == 0) {
+                addChunkToFront();
+                leftShift = chunkCapacity;
+            }
+            chunks[0]->data[leftShift-1] = value;
+            leftShift--;
+            _size++;
+        }
+
+        void pop_front() {
+            _size--;
+            leftShift++;
+            if(_size == 0) {
+                removeChunkFromFront();
+                leftShift = 0;
+            } else if(leftShift == chunkCapacity) {
+                removeChunkFromFront();
+                leftShift = 0;
+                warmUpFront();
+            }
+        }
+
+        void pop_back() {
+            _size--;
+            if(_size == 0) {
+                removeChunkFromBack();
+                leftShift = 0;
+            } else if((leftShift+_size)%chunkCapacity == 0) {
+                removeChunkFromBack();
+                warmUpBack();
+            }
+        }
+
+        /**
+         * @brief возвращает элемент; если его чанк вытеснен, читает чанк из файла
+         */
+        T& operator [](size_t i) {
+            const size_t position = leftShift+i;
+            SpillChunk* chunk = chunks[position/chunkCapacity];
+            if(chunk->state.load(std::memory_order_acquire) != State::Resident) {
+                makeResident(chunk);
+                coolDown(position/chunkCapacity, chunk);
+            }
+            return chunk->data[position%chunkCapacity];
+        }
+
+        T& front() {
+            return (*this)[0];
+        }
+
+        T& back() {
+            return (*this)[_size-1];
+        }
+
+        size_t size() const {
+            return _size;
+        }
+
+        bool empty() const {
+            return !_size;
+        }
+
+        size_t chunksCount() const {
+            return chunks.size();
+        }
+
+        size_t getChunkCapacity() const {
+            return chunkCapacity;
+        }
+
+        Stats stats() const {
+            // фоновый поток меняет счетчики под мьютексом, так что снимок согласован
+            std::lock_guard<std::mutex> lock(mutex);
+            return {spills.load(), reloads.load(), stalls.load(), residentCount.load(), pendingSpills.load()};
+        }
+
+        /**
+         * @brief дожидается, пока фоновый поток выполнит все поставленные записи и чтения
+         */
+        void wait_idle() {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobDone.wait(lock, [this]() { return jobs.empty() && !working; });
+        }
+
+    protected:
+        enum class State : uint8_t {
+            Resident, // в памяти
+            Spilling, // в памяти, фоновый поток пишет его в файл
+            Spilled,  // только в файле
+            Loading   // фоновый поток читает его из файла в уже выделенную память
+        };
+
+        struct SpillChunk {
+            T* data;
+            int64_t slot;
+            int64_t id;
+            std::atomic<State> state;
+            bool cancelSpill;
+            bool queued;
+        };
+
+        struct Job {
+            SpillChunk* chunk;
+            bool write;
+        };
+
+        size_t chunkCapacity;
+        Options options;
+        size_t leftShift;
+        size_t _size;
+
+        Deque<SpillChunk*, 64> chunks;
+        // логический номер первого чанка: чанк с номером id лежит в chunks[id-firstChunkId]
+        int64_t firstChunkId;
+
+        // номера холодных чанков в памяти в порядке, в котором их стоит вытеснять;
+        // записи проверяются при извлечении, устаревшие пропускаются
+        Deque<int64_t, 64> coldCandidates;
+
+        std::vector<int64_t> freeSlots;
+        int64_t nextSlot;
+
+        std::string spillPath;
+        int fd;
+
+        std::atomic<size_t> residentCount;
+        // чанки в состоянии Spilling: еще занимают память, но уже учтены как вытесняемые
+        std::atomic<size_t> pendingSpills;
+        std::atomic<size_t> spills;
+        std::atomic<size_t> reloads;
+        std::atomic<size_t> stalls;
+
+        mutable std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobDone;
+        std::deque<Job> jobs;
+        bool working;
+        bool stopping;
+        std::thread worker;
+
+        size_t chunkBytes() const {
+            return chunkCapacity*sizeof(T);
+        }
+
+        T* allocateChunkData() {
+            T* data = std::allocator<T>().allocate(chunkCapacity);
+            residentCount++;
+            return data;
+        }
+
+        void freeChunkData(SpillChunk* chunk) {
+            if(chunk->data != nullptr) {
+                std::allocator<T>().deallocate(chunk->data, chunkCapacity);
+                chunk->data = nullptr;
+                residentCount--;
+            }
+        }
+
+        bool isCold(size_t index) const {
+            const size_t warmChunks = options.hotChunks+options.prefetchChunks;
+            return index >= warmChunks && index+warmChunks < chunks.size();
+        }
+
+        void addChunkToBack() {
+            SpillChunk* chunk = new SpillChunk{allocateChunkData(), -1, firstChunkId+static_cast<int64_t>(chunks.size()), {State::Resident}, false, false};
+            chunks.push_back(chunk);
+            if(chunks.size() == 1) {
+                leftShift = 0;
+            }
+            coolDown(chunks.size()-1-options.hotChunks-options.prefetchChunks);
+        }
+
+        void addChunkToFront() {
+            SpillChunk* chunk = new SpillChunk{allocateChunkData(), -1, firstChunkId-1, {State::Resident}, false, false};
+            chunks.push_front(chunk);
+            firstChunkId--;
+            coolDown(options.hotChunks+options.prefetchChunks);
+        }
+
+        void removeChunkFromFront() {
+            releaseChunk(chunks[0]);
+            chunks.pop_front();
+            firstChunkId++;
+        }
+
+        void removeChunkFromBack() {
+            releaseChunk(chunks[chunks.size()-1]);
+            chunks.pop_back();
+        }
+
+        void releaseChunk(SpillChunk* chunk) {
+            makeResident(chunk);
+            if(chunk->slot >= 0) {
+                freeSlots.push_back(chunk->slot);
+            }
+            freeChunkData(chunk);
+            delete chunk;
+        }
+
+        /**
+         * @brief ставит чанк, ушедший из теплой зоны или прочитанный ради произвольного доступа,
+         * в очередь на вытеснение и вытесняет чанки, пока превышен бюджет
+         */
+        void coolDown(size_t index, const SpillChunk* pinned = nullptr) {
+            if(index < chunks.size() && isCold(index) && !chunks[index]->queued) {
+                chunks[index]->queued = true;
+                coldCandidates.push_back(chunks[index]->id);
+            }
+            rebalance(pinned);
+        }
+
+        /**
+         * @brief вытесняет чанки из очереди, пока превышен бюджет; pinned не трогает
+         *
+         * Чанки, запись которых уже поставлена в очередь, считаются вытесненными: иначе
+         * до завершения записей один вызов вытеснил бы всех кандидатов, а не только излишек.
+         */
+        void rebalance(const SpillChunk* pinned) {
+            size_t attempts = coldCandidates.size();
+            while(attempts-- && overBudget()) {
+                const int64_t id = coldCandidates[0];
+                coldCandidates.pop_front();
+
+                SpillChunk* chunk = findQueuedChunk(id);
+                if(chunk == nullptr) {
+                    continue;
+                }
+                if(chunk == pinned || chunk->state.load(std::memory_order_acquire) == State::Loading) {
+                    // вытесним в следующий раз
+                    coldCandidates.push_back(id);
+                    continue;
+                }
+                chunk->queued = false;
+                if(isCold(static_cast<size_t>(id-firstChunkId))) {
+                    spill(chunk);
+                }
+            }
+
+            if(pendingSpills.load() > options.maxResidentChunks) {
+                // запись не успевает за вытеснением: ждем, иначе память под очередь записей растет без предела
+                std::unique_lock<std::mutex> lock(mutex);
+                stalls++;
+                jobDone.wait(lock, [this]() { return pendingSpills.load() <= options.maxResidentChunks/2; });
+            }
+
+            // пока бюджет не превышен, очередь не разбирается; не даем ей расти за счет устаревших записей
+            if(coldCandidates.size() > 2*chunks.size()+64) {
+                Deque<int64_t, 64> alive;
+                for(size_t i=0; i<coldCandidates.size(); i++) {
+                    if(findQueuedChunk(coldCandidates[i]) != nullptr) {
+                        alive.push_back(coldCandidates[i]);
+                    }
+                }
+                coldCandidates.clear();
+                alive.for_each_segment([this](const int64_t* first, const int64_t* last) {
+                    coldCandidates.append(first, static_cast<size_t>(last-first));
+                });
+            }
+        }
+
+        bool overBudget() const {
+            // pendingSpills читается первым: фоновый поток уменьшает его после residentCount,
+            // так что разность может оказаться только меньше настоящей, но не больше
+            const size_t pending = pendingSpills.load();
+            return residentCount.load() > options.maxResidentChunks+pending;
+        }
+
+        /**
+         * @brief возвращает чанк с номером id, если он еще в деке и стоит в очереди на вытеснение
+         */
+        SpillChunk* findQueuedChunk(int64_t id) const {
+            const int64_t index = id-firstChunkId;
+            if(index < 0 || static_cast<size_t>(index) >= chunks.size()) {
+                return nullptr;
+            }
+            SpillChunk* chunk = chunks[static_cast<size_t>(index)];
+            return chunk->queued ? chunk : nullptr;
+        }
+
+        void warmUpFront() {
+            const size_t hotEnd = std::min(options.hotChunks, chunks.size());
+            for(size_t i=0; i<hotEnd; i++) {
+                makeResident(chunks[i]);
+            }
+            const size_t warmEnd = std::min(options.hotChunks+options.prefetchChunks, chunks.size());
+            for(size_t i=hotEnd; i<warmEnd; i++) {
+                prefetch(chunks[i]);
+            }
+        }
+
+        void warmUpBack() {
+            const size_t count = chunks.size();
+            const size_t hotCount = std::min(options.hotChunks, count);
+            for(size_t i=0; i<hotCount; i++) {
+                makeResident(chunks[count-1-i]);
+            }
+            const size_t warmCount = std::min(options.hotChunks+options.prefetchChunks, count);
+            for(size_t i=hotCount; i<warmCount; i++) {
+                prefetch(chunks[count-1-i]);
+            }
+        }
+
+        void spill(SpillChunk* chunk) {
+            if(chunk->state.load(std::memory_order_relaxed) != State::Resident) {
+                return;
+            }
+            if(chunk->slot < 0) {
+                if(!freeSlots.empty()) {
+                    chunk->slot = freeSlots.back();
+                    freeSlots.pop_back();
+                } else {
+                    chunk->slot = nextSlot++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            chunk->cancelSpill = false;
+            chunk->state.store(State::Spilling, std::memory_order_relaxed);
+            jobs.push_back({chunk, true});
+            pendingSpills++;
+            jobAvailable.notify_one();
+        }
+
+        void prefetch(SpillChunk* chunk) {
+            if(chunk->state.load(std::memory_order_acquire) != State::Spilled) {
+                return;
+            }
+            chunk->data = allocateChunkData();
+            std::lock_guard<std::mutex> lock(mutex);
+            chunk->state.store(State::Loading, std::memory_order_relaxed);
+            jobs.push_back({chunk, false});
+            jobAvailable.notify_one();
+        }
+
+        /**
+         * @brief гарантирует, что чанк в памяти, при необходимости дожидаясь фонового потока или читая файл
+         */
+        void makeResident(SpillChunk* chunk) {
+            if(chunk->state.load(std::memory_order_acquire) == State::Resident) {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            const State state = chunk->state.load(std::memory_order_relaxed);
+            if(state == State::Resident) {
+                return;
+            }
+            stalls++;
+
+            if(state == State::Spilling || state == State::Loading) {
+                chunk->cancelSpill = true;
+                jobDone.wait(lock, [chunk]() {
+                    const State current = chunk->state.load(std::memory_order_relaxed);
+                    return current == State::Resident || current == State::Spilled;
+                });
+                if(chunk->state.load(std::memory_order_relaxed) == State::Resident) {
+                    return;
+                }
+            }
+            lock.unlock();
+
+            chunk->data = allocateChunkData();
+            if(!readChunk(chunk)) {
+                const int error = errno;
+                freeChunkData(chunk);
+                throw std::system_error(error, std::generic_category(), "pread");
+            }
+            reloads++;
+            chunk->state.store(State::Resident, std::memory_order_release);
+        }
+
+        bool writeChunk(const SpillChunk* chunk) const {
+            const char* data = reinterpret_cast<const char*>(chunk->data);
+            size_t done = 0;
+            while(done < chunkBytes()) {
+                const ssize_t written = ::pwrite(fd, data+done, chunkBytes()-done, static_cast<off_t>(chunk->slot*chunkBytes()+done));
+                if(written <= 0) {
+                    return false;
+                }
+                done += static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        bool readChunk(SpillChunk* chunk) const {
+            char* data = reinterpret_cast<char*>(chunk->data);
+            size_t done = 0;
+            while(done < chunkBytes()) {
+                const ssize_t received = ::pread(fd, data+done, chunkBytes()-done, static_cast<off_t>(chunk->slot*chunkBytes()+done));
+                if(received <= 0) {
+                    return false;
+                }
+                done += static_cast<size_t>(received);
+            }
+            return true;
+        }
+
+        /**
+         * @brief фоновый поток: выполняет запись и чтение чанков по очереди заданий
+         */
+        void workerLoop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if(jobs.empty()) {
+                    return;
+                }
+                const Job job = jobs.front();
+                jobs.pop_front();
+                working = true;
+                lock.unlock();
+
+                const bool success = job.write ? writeChunk(job.chunk) : readChunk(job.chunk);
+
+                lock.lock();
+                SpillChunk* chunk = job.chunk;
+                if(job.write) {
+                    if(success && !chunk->cancelSpill) {
+                        freeChunkData(chunk);
+                        spills++;
+                        chunk->state.store(State::Spilled, std::memory_order_release);
+                    } else {
+                        chunk->state.store(State::Resident, std::memory_order_release);
+                    }
+                    pendingSpills--;
+                } else {
+                    if(success) {
+                        reloads++;
+                        chunk->state.store(State::Resident, std::memory_order_release);
+                    } else {
+                        freeChunkData(chunk);
+                        chunk->state.store(State::Spilled, std::memory_order_release);
+                    }
+                }
+                working = false;
+                jobDone.notify_all();
+            }
+        }
+    };
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <utility>
+#include "deque.h"
+
+namespace Smoren::Containers {
+    /**
+     * @brief неограниченная очередь для одного производителя и одного потребителя без блокировок
+     *
+     * Элементы лежат в чанках с той же раскладкой, что и у Deque<T, ChunkCapacity>.
+     * Производитель заполняет последний чанк и подвешивает новый, когда тот заполнен,
+     * потребитель читает первый чанк. Синхронизация только через acquire/release.
+     * Прочитанные чанки не освобождаются, а возвращаются производителю для повторного использования.
+     *
+     * push/emplace/push_n вызывает только поток-производитель,
+     * try_pop/pop_n/empty вызывает только поток-потребитель.
+     */
+    template <typename T, size_t ChunkCapacity = 1024>
+    class SpscQueue {
+        static_assert(ChunkCapacity != 0, "ChunkCapacity must be set");
+
+    public:
+        static constexpr size_t cacheLineSize = 64;
+
+        SpscQueue():
+            tailNode(new Node()),
+            tailIndex(0),
+            firstNode(tailNode),
+            headNode(tailNode),
+            headIndex(0),
+            headLimit(0)
+        {}
+
+        SpscQueue(const SpscQueue& queue) = delete;
+        SpscQueue& operator =(const SpscQueue& queue) = delete;
+
+        ~SpscQueue() {
+            Node* node = headNode.load(std::memory_order_relaxed);
+            size_t index = headIndex;
+            while(node != nullptr) {
+                const size_t limit = node->committed.load(std::memory_order_relaxed);
+                if constexpr(!std::is_trivially_destructible_v<T>) {
+                    for(; index < limit; index++) {
+                        node->data()[index].~T();
+                    }
+                }
+                node = node->next.load(std::memory_order_relaxed);
+                index = 0;
+            }
+
+            while(firstNode != nullptr) {
+                Node* next = firstNode->next.load(std::memory_order_relaxed);
+                delete firstNode;
+                firstNode = next;
+            }
+        }
+
+        template <typename... Args>
+        void emplace(Args&&... args) {
+            if(tailIndex == ChunkCapacity) {
+                linkNewNode();
+            }
+            new(tailNode->data()+tailIndex) T(std::forward<Args>(args)...);
+            ++tailIndex;
+            tailNode->committed.store(tailIndex, std::memory_order_release);
+        }
+
+        void push(const T& value) {
+            emplace(value);
+        }
+
+        void push(T&& value) {
+            emplace(std::move(value));
+        }
+
+        /**
+         * @brief добавляет count элементов из first, публикуя их один раз на чанк
+         */
+        template <typename ForwardIt>
+        void push_n(ForwardIt first, size_t count) {
+            while(count) {
+                if(tailIndex == ChunkCapacity) {
+                    linkNewNode();
+                }
+                const size_t portion = std::min(count, ChunkCapacity-tailIndex);
+                T* destination = tailNode->data()+tailIndex;
+                for(size_t i=0; i<portion; i++, ++first) {
+                    new(destination+i) T(*first);
+                }
+                tailIndex += portion;
+                tailNode->committed.store(tailIndex, std::memory_order_release);
+                count -= portion;
+            }
+        }
+
+        /**
+         * @brief извлекает первый элемент в value; возвращает false, если очередь пуста
+         */
+        bool try_pop(T& value) {
+            if(headIndex == headLimit && !refresh()) {
+                return false;
+            }
+            T* item = headNode.load(std::memory_order_relaxed)->data()+headIndex;
+            value = std::move(*item);
+            item->~T();
+            ++headIndex;
+            return true;
+        }
+
+        /**
+         * @brief перемещает в output не больше count элементов; возвращает количество извлеченных
+         */
+        template <typename OutputIt>
+        size_t pop_n(OutputIt output, size_t count) {
+            size_t result = 0;
+            while(result < count) {
+                if(headIndex == headLimit && !refresh()) {
+                    break;
+                }
+                const size_t portion = std::min(count-result, headLimit-headIndex);
+                T* first = headNode.load(std::memory_order_relaxed)->data()+headIndex;
+                output = std::move(first, first+portion, output);
+                if constexpr(!std::is_trivially_destructible_v<T>) {
+                    for(size_t i=0; i<portion; i++) {
+                        first[i].~T();
+                    }
+                }
+                headIndex += portion;
+                result += portion;
+            }
+            return result;
+        }
+
+        /**
+         * @brief проверяет, есть ли опубликованные элементы; вызывается потребителем
+         */
+        bool empty() const {
+            const Node* node = headNode.load(std::memory_order_relaxed);
+            if(headIndex < node->committed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if(headIndex < ChunkCapacity) {
+                return true;
+            }
+            const Node* next = node->next.load(std::memory_order_acquire);
+            return next == nullptr || next->committed.load(std::memory_order_acquire) == 0;
+        }
+
+    protected:
+        /**
+         * @brief чанк очереди: хранилище элементов и счетчик опубликованных элементов
+         */
+        struct Node : public ChunkStorage<T, ChunkCapacity> {
+            using ChunkStorage<T, ChunkCapacity>::data;
+
+            Node():
+                ChunkStorage<T, ChunkCapacity>(ChunkCapacity),
+                committed(0),
+                next(nullptr)
+            {}
+
+            std::atomic<size_t> committed;
+            std::atomic<Node*> next;
+        };
+
+        // данные производителя
+        alignas(cacheLineSize) Node* tailNode;
+        size_t tailIndex;
+        Node* firstNode;
+
+        // данные потребителя
+        alignas(cacheLineSize) std::atomic<Node*> headNode;
+        size_t headIndex;
+        size_t headLimit;
+
+        /**
+         * @brief подвешивает за последним чанком новый; вызывается производителем
+         *
+         * Все чанки перед текущим чанком потребителя уже прочитаны, их можно переиспользовать.
+         */
+        void linkNewNode() {
+            Node* node;
+            if(firstNode != headNode.load(std::memory_order_acquire)) {
+                node = firstNode;
+                firstNode = node->next.load(std::memory_order_relaxed);
+                node->committed.store(0, std::memory_order_relaxed);
+                node->next.store(nullptr, std::memory_order_relaxed);
+            } else {
+                node = new Node();
+            }
+            tailNode->next.store(node, std::memory_order_release);
+            tailNode = node;
+            tailIndex = 0;
+        }
+
+        /**
+         * @brief обновляет границу доступных для чтения элементов; вызывается потребителем
+         */
+        bool refresh() {
+            Node* node = headNode.load(std::memory_order_relaxed);
+            headLimit = node->committed.load(std::memory_order_acquire);
+            if(headIndex < headLimit) {
+                return true;
+            }
+            if(headIndex < ChunkCapacity) {
+                return false;
+            }
+
+            Node* next = node->next.load(std::memory_order_acquire);
+            if(next == nullptr) {
+                return false;
+            }
+            headNode.store(next, std::memory_order_release);
+            headIndex = 0;
+            headLimit = next->committed.load(std::memory_order_acquire);
+            return headLimit != 0;
+        }
+    };
+}
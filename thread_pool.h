@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Smoren::Tools {
+    /**
+     * @brief пул потоков для параллельных циклов
+     *
+     * parallel_for(count, f) вызывает f(i) для каждого i из [0, count) и возвращает управление,
+     * когда все вызовы завершены. Номера задач раздаются через атомарный счетчик, поэтому
+     * освободившийся поток сразу берет следующую задачу, а вызывающий поток работает наравне с пулом.
+     * Вложенные и одновременные вызовы parallel_for допустимы: вызывающий поток
+     * при необходимости выполнит все задачи своего цикла сам.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * @param threadsCount число потоков, выполняющих цикл, включая вызывающий
+         */
+        explicit ThreadPool(size_t threadsCount = defaultThreadsCount()):
+            stopping(false)
+        {
+            const size_t workersCount = std::max<size_t>(threadsCount, 1)-1;
+            workers.reserve(workersCount);
+            try {
+                for(size_t i=0; i<workersCount; i++) {
+                    workers.emplace_back([this] { work(); });
+                }
+            } catch(...) {
+                stop();
+                throw;
+            }
+        }
+
+        ThreadPool(const ThreadPool& pool) = delete;
+        ThreadPool& operator =(const ThreadPool& pool) = delete;
+
+        ~ThreadPool() {
+            stop();
+        }
+
+        /**
+         * @brief число потоков, выполняющих цикл, включая вызывающий
+         */
+        size_t size() const {
+            return workers.size()+1;
+        }
+
+        /**
+         * @brief вызывает f(i) для i из [0, count) параллельно и ждет завершения всех вызовов
+         *
+         * Первое исключение из f пробрасывается вызывающему, еще не начатые задачи при этом пропускаются.
+         */
+        template <typename F>
+        void parallel_for(size_t count, F&& f) {
+            if(!count) {
+                return;
+            }
+            if(count == 1 || workers.empty()) {
+                for(size_t i=0; i<count; i++) {
+                    f(i);
+                }
+                return;
+            }
+
+            using Function = std::remove_reference_t<F>;
+            Batch batch(count, [](void* context, size_t i) { (*static_cast<Function*>(context))(i); }, &f);
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                batches.push_back(&batch);
+            }
+            workAvailable.notify_all();
+
+            runTasks(batch);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                auto position = std::find(batches.begin(), batches.end(), &batch);
+                if(position != batches.end()) {
+                    batches.erase(position);
+                }
+                batchReleased.wait(lock, [&batch] { return !batch.activeWorkers; });
+            }
+            if(batch.error) {
+                std::rethrow_exception(batch.error);
+            }
+        }
+
+        /**
+         * @brief общий пул на std::thread::hardware_concurrency() потоков; создается при первом обращении
+         */
+        static ThreadPool& shared() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        static size_t defaultThreadsCount() {
+            return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+    protected:
+        /**
+         * @brief один вызов parallel_for; живет на стеке вызывающего потока
+         */
+        struct Batch {
+            Batch(size_t count, void (*invoke)(void*, size_t), void* context):
+                count(count),
+                invoke(invoke),
+                context(context),
+                next(0),
+                failed(false),
+                activeWorkers(0)
+            {}
+
+            const size_t count;
+            void (*const invoke)(void*, size_t);
+            void* const context;
+            std::atomic<size_t> next;
+            std::atomic<bool> failed;
+            std::exception_ptr error;
+            // число потоков пула, работающих с батчем; меняется под мьютексом пула
+            size_t activeWorkers;
+        };
+
+        std::vector<std::thread> workers;
+        std::deque<Batch*> batches;
+        std::mutex mutex;
+        std::condition_variable workAvailable;
+        std::condition_variable batchReleased;
+        bool stopping;
+
+        void runTasks(Batch& batch) {
+            for(size_t i=batch.next.fetch_add(1, std::memory_order_relaxed); i<batch.count; i=batch.next.fetch_add(1, std::memory_order_relaxed)) {
+                if(batch.failed.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                try {
+                    batch.invoke(batch.context, i);
+                } catch(...) {
+                    if(!batch.failed.exchange(true)) {
+                        batch.error = std::current_exception();
+                    }
+                }
+            }
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                workAvailable.wait(lock, [this] { return stopping || !batches.empty(); });
+                if(stopping) {
+                    return;
+                }
+
+                Batch* batch = batches.front();
+                if(batch->next.load(std::memory_order_relaxed) >= batch->count) {
+                    // задачи розданы, дорабатывают те, кто их взял
+                    batches.pop_front();
+                    continue;
+                }
+
+                ++batch->activeWorkers;
+                lock.unlock();
+                runTasks(*batch);
+                lock.lock();
+                if(!--batch->activeWorkers) {
+                    batchReleased.notify_all();
+                }
+            }
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                stopping = true;
+            }
+            workAvailable.notify_all();
+            for(std::thread& worker : workers) {
+                worker.join();
+            }
+            workers.clear();
+        }
+    };
+}
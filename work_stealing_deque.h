@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "deque.h"
+
+namespace Smoren::Containers {
+    /**
+     * @brief дек для планировщика задач с кражей работы (алгоритм Chase–Lev)
+     *
+     * Владелец добавляет и забирает элементы с конца без блокировок,
+     * остальные потоки крадут элементы с начала. Элементы хранятся в чанках,
+     * адресуемых через кольцо указателей, как в Deque<T, ChunkCapacity>:
+     * при росте удваивается только кольцо указателей, а уже заполненные чанки
+     * переходят в новое кольцо без копирования элементов.
+     *
+     * push_back/pop_back вызывает только поток-владелец, steal — любой поток.
+     * T должен быть тривиально копируемым (обычно указатель или дескриптор задачи).
+     */
+    template <typename T, size_t ChunkCapacity = 256>
+    class WorkStealingDeque {
+        static_assert(ChunkCapacity != 0 && (ChunkCapacity & (ChunkCapacity-1)) == 0, "ChunkCapacity must be a power of two");
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+    public:
+        static constexpr size_t cacheLineSize = 64;
+
+        explicit WorkStealingDeque(size_t initialChunksCount = 4):
+            top(0),
+            bottom(0)
+        {
+            size_t capacity = 2;
+            while(capacity < initialChunksCount) {
+                capacity *= 2;
+            }
+            Ring* ring = new Ring(capacity);
+            for(size_t i=0; i<capacity; i++) {
+                ring->chunks[i] = new Block();
+                blocks.push_back(ring->chunks[i]);
+            }
+            rings.push_back(ring);
+            currentRing.store(ring, std::memory_order_relaxed);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque& d) = delete;
+        WorkStealingDeque& operator =(const WorkStealingDeque& d) = delete;
+
+        ~WorkStealingDeque() {
+            for(Block* block : blocks) {
+                delete block;
+            }
+            for(Ring* ring : rings) {
+                delete ring;
+            }
+        }
+
+        /**
+         * @brief добавляет элемент в конец; вызывается владельцем
+         */
+        void push_back(const T& value) {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            Ring* ring = currentRing.load(std::memory_order_relaxed);
+
+            if(static_cast<size_t>(b-t) >= (ring->capacity-1)*ChunkCapacity) {
+                ring = grow(ring, t, b);
+            }
+
+            ring->slot(b).store(value, std::memory_order_relaxed);
+            bottom.store(b+1, std::memory_order_release);
+        }
+
+        /**
+         * @brief забирает элемент с конца в value; вызывается владельцем
+         */
+        bool pop_back(T& value) {
+            const int64_t b = bottom.load(std::memory_order_relaxed)-1;
+            Ring* ring = currentRing.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_seq_cst);
+
+            if(t > b) {
+                bottom.store(b+1, std::memory_order_relaxed);
+                return false;
+            }
+
+            value = ring->slot(b).load(std::memory_order_relaxed);
+            if(t == b) {
+                // последний элемент: соревнуемся с ворами
+                const bool won = top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom.store(b+1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        /**
+         * @brief крадет элемент из начала в value; вызывается любым потоком
+         *
+         * Возвращает false, если дек пуст или элемент перехватил другой поток.
+         */
+        bool steal(T& value) {
+            int64_t t = top.load(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_seq_cst);
+
+            if(t >= b) {
+                return false;
+            }
+
+            Ring* ring = currentRing.load(std::memory_order_acquire);
+            value = ring->slot(t).load(std::memory_order_relaxed);
+            return top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief возвращает приблизительное количество элементов
+         */
+        size_t size() const {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_relaxed);
+            return b > t ? static_cast<size_t>(b-t) : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+    protected:
+        /**
+         * @brief чанк элементов; слоты атомарные, так как вор может читать слот одновременно с записью владельца
+         */
+        struct Block : public ChunkStorage<std::atomic<T>, ChunkCapacity> {
+            using ChunkStorage<std::atomic<T>, ChunkCapacity>::data;
+
+            Block(): ChunkStorage<std::atomic<T>, ChunkCapacity>(ChunkCapacity) {
+                for(size_t i=0; i<ChunkCapacity; i++) {
+                    new(data()+i) std::atomic<T>();
+                }
+            }
+        };
+
+        /**
+         * @brief кольцо указателей на чанки; элемент с логическим индексом i лежит
+         * в чанке (i / ChunkCapacity) mod capacity
+         */
+        struct Ring {
+            explicit Ring(size_t capacity):
+                capacity(capacity),
+                chunks(new Block*[capacity])
+            {}
+
+            ~Ring() {
+                delete[] chunks;
+            }
+
+            std::atomic<T>& slot(int64_t index) const {
+                const size_t position = static_cast<size_t>(index);
+                return chunks[(position >> log2PowerOfTwo(ChunkCapacity)) & (capacity-1)]->data()[position & (ChunkCapacity-1)];
+            }
+
+            size_t capacity;
+            Block** chunks;
+        };
+
+        alignas(cacheLineSize) std::atomic<int64_t> top;
+        alignas(cacheLineSize) std::atomic<int64_t> bottom;
+        alignas(cacheLineSize) std::atomic<Ring*> currentRing;
+
+        // кольца и чанки принадлежат владельцу и освобождаются только в деструкторе:
+        // вор может еще читать через устаревшее кольцо
+        std::vector<Ring*> rings;
+        std::vector<Block*> blocks;
+
+        /**
+         * @brief удваивает кольцо, перенося указатели на чанки живого диапазона [t, b)
+         */
+        Ring* grow(Ring* ring, int64_t t, int64_t b) {
+            constexpr size_t shift = log2PowerOfTwo(ChunkCapacity);
+            Ring* newRing = new Ring(ring->capacity*2);
+            rings.push_back(newRing);
+
+            std::vector<bool> used(newRing->capacity, false);
+            const size_t firstChunk = static_cast<size_t>(t) >> shift;
+            const size_t lastChunk = static_cast<size_t>(b) >> shift;
+            for(size_t chunk=firstChunk; chunk<=lastChunk; chunk++) {
+                const size_t index = chunk & (newRing->capacity-1);
+                newRing->chunks[index] = ring->chunks[chunk & (ring->capacity-1)];
+                used[index] = true;
+            }
+
+            // в свободные позиции кладем оставшиеся старые чанки, недостающие создаем
+            size_t spare = 0;
+            for(size_t chunk=lastChunk+1; chunk<firstChunk+ring->capacity; chunk++) {
+                while(used[spare]) {
+                    spare++;
+                }
+                newRing->chunks[spare] = ring->chunks[chunk & (ring->capacity-1)];
+                used[spare] = true;
+            }
+            for(size_t index=0; index<newRing->capacity; index++) {
+                if(!used[index]) {
+                    newRing->chunks[index] = new Block();
+                    blocks.push_back(newRing->chunks[index]);
+                }
+            }
+
+            currentRing.store(newRing, std::memory_order_release);
+            return newRing;
+        }
+    };
+}